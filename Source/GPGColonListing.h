@@ -0,0 +1,77 @@
+//
+//  GPGColonListing.h
+//  Libmacgpg
+//
+
+#import <Foundation/Foundation.h>
+#import "GPGGlobals.h"
+
+// gpg's colon listings have 21 fields at most. Additional fields are ignored.
+#define GPGColonListingMaxFields 24
+
+// A field of a record. The bytes point into the data of the listing and are not NUL-terminated.
+typedef struct {
+	const char *bytes;
+	NSUInteger length;
+} GPGColonField;
+
+// One tokenized line of the listing. Missing fields are empty.
+typedef struct {
+	NSUInteger count;
+	GPGColonField fields[GPGColonListingMaxFields];
+} GPGColonRecord;
+
+
+/*
+ * A parser for the output of "gpg --with-colons".
+ *
+ * The data is scanned once for line breaks. A line is only split into fields, when it's requested,
+ * and the fields are not copied. NSStrings are only created for the fields which are actually used,
+ * with the functions below.
+ */
+@interface GPGColonListing : NSObject {
+	NSData *_data;
+	NSUInteger *_lineStarts; // _lineCount + 1 entries, the last one is the end of the data.
+	NSUInteger _lineCount;
+}
+
++ (instancetype)listingWithData:(NSData *)data;
+- (instancetype)initWithData:(NSData *)data;
+
+@property (nonatomic, readonly) NSUInteger lineCount;
+
+// Splits the line at index into record. Returns NO if index is out of bounds.
+- (BOOL)getRecord:(GPGColonRecord *)record atLine:(NSUInteger)index;
+// YES if the first field of the line at index is type, e.g. "pub". Doesn't split the line.
+- (BOOL)line:(NSUInteger)index hasType:(const char *)type;
+// A 64 bit FNV-1a hash of the lines in range, including the line breaks. Used to detect changed keys.
+- (uint64_t)hashOfLinesInRange:(NSRange)range;
+
+@end
+
+
+// Returns the field at index, or an empty field.
+static inline GPGColonField GPGColonRecordField(const GPGColonRecord *record, NSUInteger index) {
+	if (index < record->count) {
+		return record->fields[index];
+	}
+	GPGColonField empty = {"", 0};
+	return empty;
+}
+
+// YES if the field is exactly string.
+BOOL GPGColonFieldIsEqual(GPGColonField field, const char *string);
+// YES if the first field of the record is type, e.g. "pub".
+BOOL GPGColonRecordHasType(const GPGColonRecord *record, const char *type);
+// The field as NSString. The field is expected to be UTF-8, ISO Latin 1 is used as fallback.
+NSString *GPGColonFieldString(GPGColonField field);
+// Like GPGColonFieldString, but decodes gpg's escapes ("\x3a" -> ":").
+NSString *GPGColonFieldUnescapedString(GPGColonField field);
+// The leading decimal number of the field, like -[NSString integerValue].
+NSInteger GPGColonFieldInteger(GPGColonField field);
+// Like +[NSDate dateWithGPGString:]: Seconds since epoch or ISO 8601 ("20180530T120000"). nil for 0 and empty fields.
+NSDate *GPGColonFieldDate(GPGColonField field);
+// Like GPGColonFieldDate, but seconds since epoch without creating an NSDate. 0 for 0 and empty fields.
+int64_t GPGColonFieldTimestamp(GPGColonField field);
+// The validity for the letter in the first byte of the field, e.g. "f" -> GPGValidityFull.
+GPGValidity GPGColonFieldValidity(GPGColonField field);
@@ -0,0 +1,266 @@
+//
+//  GPGColonListing.m
+//  Libmacgpg
+//
+
+#import "GPGColonListing.h"
+#import <time.h>
+
+
+@implementation GPGColonListing
+@synthesize lineCount = _lineCount;
+
++ (instancetype)listingWithData:(NSData *)data {
+	return [[[self alloc] initWithData:data] autorelease];
+}
+
+- (instancetype)initWithData:(NSData *)data {
+	self = [super init];
+	if (!self) {
+		return nil;
+	}
+
+	_data = data ? [data copy] : [[NSData alloc] init];
+
+	const char *bytes = _data.bytes;
+	NSUInteger length = _data.length;
+
+	// Count the lines first, so the offsets can be stored in one buffer.
+	NSUInteger count = 0;
+	const char *position = bytes;
+	const char *end = bytes + length;
+	while (position < end && (position = memchr(position, '\n', end - position))) {
+		count++;
+		position++;
+	}
+	if (length > 0 && bytes[length - 1] != '\n') {
+		count++; // Last line without line break.
+	}
+
+	_lineStarts = malloc((count + 1) * sizeof(NSUInteger));
+	if (!_lineStarts) {
+		[self release];
+		return nil;
+	}
+
+	NSUInteger line = 0;
+	position = bytes;
+	_lineStarts[0] = 0;
+	while (line < count) {
+		const char *lineEnd = memchr(position, '\n', end - position);
+		position = lineEnd ? lineEnd + 1 : end;
+		_lineStarts[++line] = position - bytes;
+	}
+	_lineCount = count;
+
+	return self;
+}
+
+- (void)dealloc {
+	free(_lineStarts);
+	[_data release];
+	[super dealloc];
+}
+
+// The bytes of the line at index, without the line break.
+- (const char *)bytesOfLine:(NSUInteger)index length:(NSUInteger *)length {
+	const char *bytes = _data.bytes;
+	NSUInteger start = _lineStarts[index];
+	NSUInteger end = _lineStarts[index + 1];
+
+	if (end > start && bytes[end - 1] == '\n') {
+		end--;
+	}
+	if (end > start && bytes[end - 1] == '\r') {
+		end--;
+	}
+	*length = end - start;
+	return bytes + start;
+}
+
+- (BOOL)getRecord:(GPGColonRecord *)record atLine:(NSUInteger)index {
+	if (index >= _lineCount) {
+		record->count = 0;
+		return NO;
+	}
+
+	NSUInteger length;
+	const char *position = [self bytesOfLine:index length:&length];
+	const char *end = position + length;
+	NSUInteger count = 0;
+
+	while (count < GPGColonListingMaxFields) {
+		const char *separator = memchr(position, ':', end - position);
+		const char *fieldEnd = separator ? separator : end;
+
+		record->fields[count].bytes = position;
+		record->fields[count].length = fieldEnd - position;
+		count++;
+
+		if (!separator) {
+			break;
+		}
+		position = separator + 1;
+	}
+	record->count = count;
+
+	return YES;
+}
+
+- (BOOL)line:(NSUInteger)index hasType:(const char *)type {
+	if (index >= _lineCount) {
+		return NO;
+	}
+	NSUInteger length;
+	const char *bytes = [self bytesOfLine:index length:&length];
+	size_t typeLength = strlen(type);
+
+	return length >= typeLength && memcmp(bytes, type, typeLength) == 0 && (length == typeLength || bytes[typeLength] == ':');
+}
+
+- (uint64_t)hashOfLinesInRange:(NSRange)range {
+	uint64_t hash = 14695981039346656037ULL;
+	if (range.length == 0 || range.location + range.length > _lineCount) {
+		return hash;
+	}
+
+	const uint8_t *bytes = _data.bytes;
+	NSUInteger end = _lineStarts[range.location + range.length];
+	for (NSUInteger i = _lineStarts[range.location]; i < end; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+@end
+
+
+
+BOOL GPGColonFieldIsEqual(GPGColonField field, const char *string) {
+	size_t length = strlen(string);
+	return field.length == length && memcmp(field.bytes, string, length) == 0;
+}
+
+BOOL GPGColonRecordHasType(const GPGColonRecord *record, const char *type) {
+	return record->count > 0 && GPGColonFieldIsEqual(record->fields[0], type);
+}
+
+NSString *GPGColonFieldString(GPGColonField field) {
+	if (field.length == 0) {
+		return @"";
+	}
+	NSString *string = [[NSString alloc] initWithBytes:field.bytes length:field.length encoding:NSUTF8StringEncoding];
+	if (!string) {
+		string = [[NSString alloc] initWithBytes:field.bytes length:field.length encoding:NSISOLatin1StringEncoding];
+	}
+	return [string autorelease];
+}
+
+NSString *GPGColonFieldUnescapedString(GPGColonField field) {
+	if (!memchr(field.bytes, '\\', field.length)) {
+		return GPGColonFieldString(field);
+	}
+
+	char *unescaped = malloc(field.length);
+	if (!unescaped) {
+		return nil;
+	}
+	GPGColonField unescapedField = {unescaped, unescapeBytes(field.bytes, field.length, unescaped)};
+	NSString *string = GPGColonFieldString(unescapedField);
+	free(unescaped);
+
+	return string;
+}
+
+NSInteger GPGColonFieldInteger(GPGColonField field) {
+	const char *position = field.bytes;
+	const char *end = position + field.length;
+	BOOL negative = NO;
+
+	if (position < end && (*position == '-' || *position == '+')) {
+		negative = *position == '-';
+		position++;
+	}
+
+	NSInteger value = 0;
+	for (; position < end && *position >= '0' && *position <= '9'; position++) {
+		value = value * 10 + (*position - '0');
+	}
+
+	return negative ? -value : value;
+}
+
+// Parses count digits at bytes. Returns -1 if there is a non-digit.
+static int parseDigits(const char *bytes, int count) {
+	int value = 0;
+	for (int i = 0; i < count; i++) {
+		if (bytes[i] < '0' || bytes[i] > '9') {
+			return -1;
+		}
+		value = value * 10 + (bytes[i] - '0');
+	}
+	return value;
+}
+
+int64_t GPGColonFieldTimestamp(GPGColonField field) {
+	NSInteger seconds = GPGColonFieldInteger(field);
+	if (seconds == 0) {
+		return 0;
+	}
+
+	if (field.length >= 15 && field.bytes[8] == 'T') {
+		const char *bytes = field.bytes;
+		struct tm time = {0};
+		time.tm_year = parseDigits(bytes, 4) - 1900;
+		time.tm_mon = parseDigits(bytes + 4, 2) - 1;
+		time.tm_mday = parseDigits(bytes + 6, 2);
+		time.tm_hour = parseDigits(bytes + 9, 2);
+		time.tm_min = parseDigits(bytes + 11, 2);
+		time.tm_sec = parseDigits(bytes + 13, 2);
+
+		if (time.tm_mon < 0 || time.tm_mday < 0 || time.tm_hour < 0 || time.tm_min < 0 || time.tm_sec < 0) {
+			return 0;
+		}
+
+		return timegm(&time);
+	}
+
+	return seconds;
+}
+
+NSDate *GPGColonFieldDate(GPGColonField field) {
+	int64_t seconds = GPGColonFieldTimestamp(field);
+	if (seconds == 0) {
+		return nil;
+	}
+	return [NSDate dateWithTimeIntervalSince1970:seconds];
+}
+
+GPGValidity GPGColonFieldValidity(GPGColonField field) {
+	if (field.length == 0) {
+		return GPGValidityUnknown;
+	}
+	switch (field.bytes[0]) {
+		case 'q':
+			return GPGValidityUndefined;
+		case 'n':
+			return GPGValidityNever;
+		case 'm':
+			return GPGValidityMarginal;
+		case 'f':
+			return GPGValidityFull;
+		case 'u':
+			return GPGValidityUltimate;
+		case 'i':
+			return GPGValidityInvalid;
+		case 'r':
+			return GPGValidityRevoked;
+		case 'e':
+			return GPGValidityExpired;
+		case 'd':
+			return GPGValidityDisabled;
+	}
+	return GPGValidityUnknown;
+}
@@ -0,0 +1,34 @@
+//
+//  GPGColonListingStream.h
+//  Libmacgpg
+//
+
+#import <Libmacgpg/GPGStream.h>
+
+@class GPGColonListing;
+
+/*
+ * An output stream for gpg's key listings, which hands the keys to a handler while gpg is still running.
+ *
+ * The output is collected until a line starting with "pub:" arrives. All lines before it belong to
+ * complete keys and are passed to the handler as a GPGColonListing. The rest stays in the stream,
+ * until the next key starts or -finish is called.
+ * The handler is called on the thread writing the stream, one call at a time.
+ */
+@interface GPGColonListingStream : GPGStream {
+	void (^_handler)(GPGColonListing *listing);
+	NSMutableData *_pendingData;
+	NSUInteger _scannedLength; // The part of _pendingData without a key start.
+	NSMutableData *_allData;
+	unsigned long long _length;
+}
+
+- (instancetype)initWithHandler:(void (^)(GPGColonListing *listing))handler;
+
+// Passes the remaining lines to the handler. Call it after gpg is done.
+- (void)finish;
+
+// If YES, the whole output is kept and returned by readAllData. Otherwise readAllData returns empty data.
+@property (nonatomic) BOOL keepsData;
+
+@end
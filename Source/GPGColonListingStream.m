@@ -0,0 +1,91 @@
+//
+//  GPGColonListingStream.m
+//  Libmacgpg
+//
+
+#import "GPGColonListingStream.h"
+#import "GPGColonListing.h"
+#import "GPGGlobals.h"
+
+#define KEY_START "\npub:"
+#define KEY_START_LENGTH 5
+
+
+@implementation GPGColonListingStream
+
+- (instancetype)initWithHandler:(void (^)(GPGColonListing *listing))handler {
+	self = [super init];
+	if (!self) {
+		return nil;
+	}
+
+	_handler = [handler copy];
+	_pendingData = [[NSMutableData alloc] init];
+
+	return self;
+}
+
+- (void)dealloc {
+	[_handler release];
+	[_pendingData release];
+	[_allData release];
+	[super dealloc];
+}
+
+- (BOOL)keepsData {
+	return _allData != nil;
+}
+
+- (void)setKeepsData:(BOOL)keepsData {
+	if (keepsData && !_allData) {
+		_allData = [[NSMutableData alloc] init];
+	} else if (!keepsData) {
+		[_allData release];
+		_allData = nil;
+	}
+}
+
+- (void)writeData:(NSData *)data {
+	_length += data.length;
+	[_allData appendData:data];
+	[_pendingData appendData:data];
+
+	// Search for the start of the last key. A key start can span two writes, so the end of the
+	// previous write is searched again.
+	const char *bytes = _pendingData.bytes;
+	NSUInteger length = _pendingData.length;
+	const char *position = bytes + (_scannedLength >= KEY_START_LENGTH ? _scannedLength - KEY_START_LENGTH + 1 : 0);
+	const char *found;
+	NSUInteger split = 0;
+	while ((found = lm_memmem(position, bytes + length - position, KEY_START, KEY_START_LENGTH))) {
+		split = found - bytes + 1;
+		position = found + 1;
+	}
+	_scannedLength = length;
+
+	if (split > 0) {
+		NSData *completeKeys = [_pendingData subdataWithRange:NSMakeRange(0, split)];
+		[_pendingData replaceBytesInRange:NSMakeRange(0, split) withBytes:NULL length:0];
+		_scannedLength -= split;
+		_handler([GPGColonListing listingWithData:completeKeys]);
+	}
+}
+
+- (void)finish {
+	if (_pendingData.length > 0) {
+		NSData *lastKey = [[_pendingData copy] autorelease];
+		_pendingData.length = 0;
+		_scannedLength = 0;
+		_handler([GPGColonListing listingWithData:lastKey]);
+	}
+}
+
+- (NSData *)readAllData {
+	return _allData ? [[_allData retain] autorelease] : [NSData data];
+}
+
+- (unsigned long long)length {
+	return _length;
+}
+
+@end
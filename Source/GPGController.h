@@ -27,6 +27,7 @@
 @class GPGController;
 @class GPGStream;
 @class GPGRemoteKey;
+@class GPGKeyEditTransaction;
 
 
 @protocol GPGControllerDelegate
@@ -89,6 +90,7 @@
 	BOOL decrypted;
 	
 	NSMutableSet *gpgKeyservers;
+	NSArray *concurrentTasks; // The tasks run at the same time by the current operation. cancel cancels them too.
 }
 
 @property (nonatomic, assign) NSObject <GPGControllerDelegate> *delegate;
@@ -153,6 +155,8 @@
 - (BOOL)isPassphraseForKeyInCache:(NSObject <KeyFingerprint> *)key;
 - (BOOL)isPassphraseForKeyInGPGAgentCache:(NSObject <KeyFingerprint> *)key;
 - (BOOL)isPassphraseForKeyInKeychain:(NSObject <KeyFingerprint> *)key;
+/* The 1-based index used by --edit-key, 0 if not found. Taken from the keys loaded by GPGKeyManager,
+ * gpg is only asked if the keyring files changed since they were loaded. */
 - (NSInteger)indexOfUserID:(NSString *)hashID fromKey:(NSObject <KeyFingerprint> *)key;
 - (NSInteger)indexOfSubkey:(NSObject <KeyFingerprint> *)subkey fromKey:(NSObject <KeyFingerprint> *)key;
 
@@ -192,6 +196,8 @@
 - (void)removeSubkey:(NSObject <KeyFingerprint> *)subkey fromKey:(NSObject <KeyFingerprint> *)key;
 - (void)revokeSubkey:(NSObject <KeyFingerprint> *)subkey fromKey:(NSObject <KeyFingerprint> *)key reason:(int)reason description:(NSString *)description;
 - (void)setPrimaryUserID:(NSString *)hashID ofKey:(NSObject <KeyFingerprint> *)key;
+/* Runs all edits of transaction with one gpg --edit-key session per key, where possible. See GPGKeyEditTransaction. */
+- (void)performKeyEditTransaction:(GPGKeyEditTransaction *)transaction;
 - (NSString *)generateNewKeyWithName:(NSString *)name email:(NSString *)email comment:(NSString *)comment
 							 keyType:(GPGPublicKeyAlgorithm)keyType keyLength:(int)keyLength
 						  subkeyType:(GPGPublicKeyAlgorithm)subkeyType subkeyLength:(int)subkeyLength
@@ -207,11 +213,22 @@
 - (void)key:(NSObject <KeyFingerprint> *)key setOwnerTrsut:(GPGValidity)trust DEPRECATED_ATTRIBUTE;
 - (void)key:(NSObject <KeyFingerprint> *)key setOwnerTrust:(GPGValidity)trust;
 
+/* With GPGSeparateSign and an encrypt mode, one gpg signs the input while another encrypts the signed data.
+ * output is written while they run, so it may contain a partial message when an error is reported. */
 - (void)processTo:(GPGStream *)output data:(GPGStream *)input withEncryptSignMode:(GPGEncryptSignMode)encryptSignMode 
 			 recipients:(NSObject <EnumerationList> *)recipients hiddenRecipients:(NSObject <EnumerationList> *)hiddenRecipients;
 - (NSData *)processData:(NSData *)data withEncryptSignMode:(GPGEncryptSignMode)encryptSignMode 
 			 recipients:(NSObject <EnumerationList> *)recipients hiddenRecipients:(NSObject <EnumerationList> *)hiddenRecipients;
 
+/* Encrypts the same input once for every set of recipients, e.g. one message per group. outputs[i] gets the
+ * message for recipientSets[i]. The gpgs run in parallel, a few at a time.
+ * The input stream is only read once: into memory if it's small, otherwise into a temporary file.
+ * GPGSeparateSign isn't supported. */
+- (void)processTo:(NSArray <GPGStream *> *)outputs data:(GPGStream *)input withEncryptSignMode:(GPGEncryptSignMode)encryptSignMode
+	recipientSets:(NSArray <NSObject <EnumerationList> *> *)recipientSets;
+- (NSArray <NSData *> *)processData:(NSData *)data withEncryptSignMode:(GPGEncryptSignMode)encryptSignMode
+	recipientSets:(NSArray <NSObject <EnumerationList> *> *)recipientSets;
+
 - (void)decryptTo:(GPGStream *)output data:(GPGStream *)input;
 - (NSData *)decryptData:(NSData *)data;
 
@@ -22,6 +22,7 @@
 #import "GPGTypesRW.h"
 #import "GPGKeyserver.h"
 #import "GPGTaskHelper.h"
+#import "GPGTaskLaunchContext.h"
 #import "GPGWatcher.h"
 #import "GPGTask_Private.h"
 #import "GPGVerifyingKeyserver.h"
@@ -29,13 +30,36 @@
 #if defined(__MAC_OS_X_VERSION_MAX_ALLOWED) && __MAC_OS_X_VERSION_MAX_ALLOWED >= 1080
 #import "GPGTaskHelperXPC.h"
 #import "NSBundle+Sandbox.h"
+#import "NSPipe+NoSigPipe.h"
+#import "GPGStreamSpool.h"
 #endif
 
+// The maximum number of gpg processes run at once by the methods with recipientSets.
+#define MAX_CONCURRENT_PROCESS_TASKS 4
 #define cancelCheck if (canceled) {@throw [GPGException exceptionWithReason:localizedLibmacgpgString(@"Operation cancelled") errorCode:GPGErrorCancelled];}
 
 
 static NSString * const keysOnServerCacheKey = @"KeysOnServerCache";
 
+// Returns the tag of the first packet in data, decoding only the start of armored data. 0 if data doesn't start with a packet.
+static GPGPacketTag firstPacketTagOfData(NSData *data) {
+	if (data.isArmored) {
+		data = [[GPGUnArmor unArmorWithGPGStream:[GPGMemoryStream memoryStreamForReading:data]] decodeHeader];
+		if (data.length == 0 || data.isArmored) {
+			return 0;
+		}
+	}
+	if (data.length == 0) {
+		return 0;
+	}
+	UInt8 byte = ((const UInt8 *)data.bytes)[0];
+	if ((byte & 0x80) == 0) {
+		// Every packet header has bit 7 set.
+		return 0;
+	}
+	return (byte & 0x40) ? (byte & 0x3F) : ((byte & 0x3C) >> 2);
+}
+
 @interface GPGController () <GPGTaskDelegate>
 @property (nonatomic, retain) GPGSignature *lastSignature;
 @property (nonatomic, retain) NSString *filename;
@@ -59,6 +83,100 @@ static NSString * const keysOnServerCacheKey = @"KeysOnServerCache";
 - (void)registerUndoForKey:(NSObject <KeyFingerprint> *)key withName:(NSString *)actionName;
 - (void)registerUndoForKeys:(NSObject <EnumerationList> *)keys;
 - (void)logException:(NSException *)e;
+- (void)processTo:(NSArray <GPGStream *> *)outputs inputs:(NSArray <GPGStream *> *)inputs withEncryptSignMode:(GPGEncryptSignMode)mode recipientSets:(NSArray <NSObject <EnumerationList> *> *)recipientSets;
+- (void)addArgumentsForEncryptMode:(GPGEncryptSignMode)mode recipients:(NSObject<EnumerationList> *)recipients hiddenRecipients:(NSObject<EnumerationList> *)hiddenRecipients;
+- (void)addArgumentsForSignMode:(GPGEncryptSignMode)mode;
+- (GPGTask *)separateSignTaskWithMode:(GPGEncryptSignMode)mode input:(GPGStream *)input;
+- (void)runKeyEdits:(NSArray *)edits ofKey:(GPGKey *)key signerKey:(NSString *)signerKey defaultBoolAnswer:(BoolAnswer)defaultBoolAnswer indexes:(NSMapTable *)indexes;
+- (void)addCommandsForKeyEdit:(GPGKeyEdit *)edit indexes:(NSIndexSet *)indexes toOrder:(GPGTaskOrder *)order;
+- (void)runKeyEditOrder:(GPGTaskOrder *)order ofKey:(GPGKey *)key signerKey:(NSString *)signerKey signs:(BOOL)signs addsUserID:(BOOL)addsUserID;
+- (NSArray <GPGTaskOrder *> *)signatureOrdersForKeyEdits:(NSArray *)edits indexes:(NSMapTable *)indexes;
+- (void)addSelectionOfIndexes:(NSIndexSet *)indexes subkeys:(BOOL)subkeys toOrder:(GPGTaskOrder *)order;
+- (void)addRevocationReason:(int)reason description:(NSString *)description toOrder:(GPGTaskOrder *)order;
+- (NSIndexSet *)indexesForKeyEdit:(GPGKeyEdit *)edit;
+- (GPGKey *)upToDateKeyForKey:(NSObject <KeyFingerprint> *)key;
+- (NSSet *)keysInStream:(GPGStream *)stream encrypted:(BOOL *)encrypted;
+- (NSSet *)fingerprintsOfKeysInImportData:(NSData *)data;
+@end
+
+
+/*
+ * The delegate of gpg tasks, which a GPGController runs at the same time.
+ * Passes the callbacks of all tasks to the controller one at a time. gpgTaskWillStart: is only passed for the
+ * first task, so no task resets the signatures found by another. The progress is summed up over all tasks.
+ */
+@interface GPGConcurrentTaskDelegate : NSObject <GPGTaskDelegate> {
+	GPGController *_controller; // Not retained, the controller waits for its tasks.
+	NSMutableArray *_tasks;
+	NSMapTable *_progress; // GPGTask -> @[progressed, total]
+	BOOL _started;
+}
+- (instancetype)initWithController:(GPGController *)controller;
+/* Sets the task's delegate to the receiver. The receiver must live until the task has finished. */
+- (void)addTask:(GPGTask *)task;
+@end
+
+@implementation GPGConcurrentTaskDelegate
+
+- (instancetype)initWithController:(GPGController *)controller {
+	self = [super init];
+	if (!self) {
+		return nil;
+	}
+
+	_controller = controller;
+	_tasks = [[NSMutableArray alloc] init];
+	_progress = [[NSMapTable strongToStrongObjectsMapTable] retain];
+
+	return self;
+}
+
+- (void)dealloc {
+	[_tasks release];
+	[_progress release];
+	[super dealloc];
+}
+
+- (void)addTask:(GPGTask *)task {
+	task.delegate = self;
+	@synchronized (self) {
+		[_tasks addObject:task];
+	}
+}
+
+- (id)gpgTask:(GPGTask *)task statusCode:(NSInteger)status prompt:(NSString *)prompt {
+	@synchronized (self) {
+		return [_controller gpgTask:task statusCode:status prompt:prompt];
+	}
+}
+
+- (void)gpgTaskWillStart:(GPGTask *)task {
+	@synchronized (self) {
+		if (!_started) {
+			_started = YES;
+			[_controller gpgTaskWillStart:task];
+		}
+	}
+}
+
+- (void)gpgTask:(GPGTask *)task progressed:(NSInteger)progressed total:(NSInteger)total {
+	@synchronized (self) {
+		[_progress setObject:@[@(progressed), @(total)] forKey:task];
+		
+		NSInteger allProgressed = 0, allTotal = 0;
+		for (GPGTask *aTask in _tasks) {
+			if (!aTask.progressInfo) {
+				continue;
+			}
+			NSArray *values = [_progress objectForKey:aTask];
+			allProgressed += [values[0] integerValue];
+			// Until a task reports its own total, assume it's the same as this one's.
+			allTotal += values ? [values[1] integerValue] : total;
+		}
+		[_controller gpgTask:task progressed:allProgressed total:allTotal];
+	}
+}
+
 @end
 
 
@@ -249,6 +367,13 @@ BOOL gpgConfigReaded = NO;
 	if (gpgTask.isRunning) {
 		[gpgTask cancel];
 	}
+	NSArray *tasks = nil;
+	@synchronized (self) {
+		tasks = [[concurrentTasks retain] autorelease];
+	}
+	for (GPGTask *task in tasks) {
+		[task cancel];
+	}
 	for (GPGKeyserver *server in gpgKeyservers) {
 		if (server.isRunning) {
 			[server cancel];
@@ -302,70 +427,19 @@ BOOL gpgConfigReaded = NO;
 		[self addArgumentsForSignerKeys];
 		
 		
-		if (mode & GPGPublicKeyEncrypt) {
-			[gpgTask addArgument:@"--encrypt"];
-			if ([recipients count] + [hiddenRecipients count] == 0) {
-				[NSException raise:NSInvalidArgumentException format:@"No recipient specified!"];
-			}
-			
-			Class gpgKeyClass = [GPGKey class];
-			
-			for (GPGKey *recipient in recipients) {
-				[gpgTask addArgument:@"--recipient"];
-				
-				if ([recipient isKindOfClass:gpgKeyClass] && recipient.primaryKey != recipient) {
-					// Is a subkey. Force gpg to use exact this subkey.
-					[gpgTask addArgument:[NSString stringWithFormat:@"%@!", recipient.description]];
-				} else {
-					[gpgTask addArgument:recipient.description];
-				}
-			}
-			for (GPGKey *recipient in hiddenRecipients) {
-				[gpgTask addArgument:@"--hidden-recipient"];
-				
-				if ([recipient isKindOfClass:gpgKeyClass] && recipient.primaryKey != recipient) {
-					// Is a subkey. Force gpg to use exact this subkey.
-					[gpgTask addArgument:[NSString stringWithFormat:@"%@!", recipient.description]];
-				} else {
-					[gpgTask addArgument:recipient.description];
-				}
-			}
-		}
-		if (mode & GPGSymetricEncrypt) {
-			[gpgTask addArgument:@"--symmetric"];
-		}
+		[self addArgumentsForEncryptMode:mode recipients:recipients hiddenRecipients:hiddenRecipients];
 		
+		GPGTask *signTask = nil;
+		NSPipe *signPipe = nil;
 		if ((mode & GPGSeparateSign) && (mode & GPGEncryptFlags)) {
-			// save object; processTo: will overwrite without releasing
-			GPGTask *tempTask = gpgTask;
-
-			// create new in-memory writeable stream
-			GPGMemoryStream *sigoutput = [GPGMemoryStream memoryStream];
-			[self processTo:sigoutput data:input withEncryptSignMode:mode & ~(GPGEncryptFlags | GPGSeparateSign) recipients:nil hiddenRecipients:nil];
-			input = sigoutput;
-
-			// reset back to the outer gpg task
-			self.gpgTask = tempTask;
+			// A second gpg signs the input and its output is piped into this gpg.
+			// So both run at the same time and the signed data is never kept in memory.
+			signPipe = [[NSPipe pipe] noSIGPIPE];
+			signTask = [self separateSignTaskWithMode:mode input:input];
+			signTask.outStream = [GPGFileHandleStream streamForWritingToFileHandle:signPipe.fileHandleForWriting];
+			input = [GPGFileHandleStream streamForReadingFromFileHandle:signPipe.fileHandleForReading length:input.length];
 		} else {
-			switch (mode & GPGSignFlags & ~GPGSeparateSign) {
-				case GPGSign:
-					[gpgTask addArgument:@"--sign"];
-					break;
-				case GPGClearSign:
-					[gpgTask addArgument:@"--clearsign"];
-					break;
-				case GPGDetachedSign:
-					[gpgTask addArgument:@"--detach-sign"];
-					break;
-				case 0:
-					if (mode & GPGSeparateSign) {
-						[gpgTask addArgument:@"--sign"];
-					}
-					break;
-				default:			
-					[NSException raise:NSInvalidArgumentException format:@"Unknown sign mode: %i!", mode & GPGSignFlags];
-					break;
-			}			
+			[self addArgumentsForSignMode:mode];
 		}
 		if (self.forceFilename) {
 			[gpgTask addArgument:@"--set-filename"];
@@ -375,7 +449,58 @@ BOOL gpgConfigReaded = NO;
 		gpgTask.outStream = output;
 		[gpgTask setInput:input];
 
-		[gpgTask start];
+		if (signTask) {
+			// The tasks run at the same time, so their callbacks are passed on one at a time.
+			// Only the encrypting gpg reports progress, both read the same amount of data.
+			GPGConcurrentTaskDelegate *taskDelegate = [[[GPGConcurrentTaskDelegate alloc] initWithController:self] autorelease];
+			signTask.progressInfo = NO;
+			signTask.timeout = timeout;
+			gpgTask.timeout = timeout;
+			[taskDelegate addTask:gpgTask];
+			[taskDelegate addTask:signTask];
+			@synchronized (self) {
+				concurrentTasks = [@[signTask] retain];
+			}
+			
+			__block NSException *signException = nil;
+			dispatch_group_t signGroup = dispatch_group_create();
+			dispatch_group_async(signGroup, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+				@autoreleasepool {
+					@try {
+						[signTask start];
+					} @catch (NSException *exception) {
+						signException = [exception retain];
+					} @finally {
+						// End of input for the encrypting gpg.
+						[signPipe.fileHandleForWriting closeFile];
+					}
+				}
+			});
+			
+			@try {
+				[gpgTask start];
+			} @finally {
+				// If the encrypting gpg stopped reading early, the signing gpg gets an error instead of blocking.
+				[signPipe.fileHandleForReading closeFile];
+				dispatch_group_wait(signGroup, DISPATCH_TIME_FOREVER);
+				dispatch_release(signGroup);
+				@synchronized (self) {
+					[concurrentTasks release];
+					concurrentTasks = nil;
+				}
+			}
+			
+			// The encrypting gpg has already written to output. A failure of the signing gpg is reported first,
+			// because the encrypting one only sees the truncated input.
+			if (signException) {
+				@throw [signException autorelease];
+			}
+			if (signTask.statusDict[@"FAILURE"]) {
+				@throw [GPGException exceptionWithReason:localizedLibmacgpgString(@"Encrypt/sign failed!") gpgTask:signTask];
+			}
+		} else {
+			[gpgTask start];
+		}
 		
 		// The status FAILURE is issued, whenever a sign or encrypt operation failed.
 		// It is better to only use FAILURE and ignore exitcode and other status codes.
@@ -387,6 +512,235 @@ BOOL gpgConfigReaded = NO;
 	}	
 }
 
+- (NSArray <NSData *> *)processData:(NSData *)data withEncryptSignMode:(GPGEncryptSignMode)mode recipientSets:(NSArray <NSObject <EnumerationList> *> *)recipientSets {
+	if (async && !asyncStarted) {
+		asyncStarted = YES;
+		[asyncProxy processData:data withEncryptSignMode:mode recipientSets:recipientSets];
+		return nil;
+	}
+	
+	NSMutableArray *processedData = nil;
+	@try {
+		[self operationDidStart];
+		
+		NSUInteger count = recipientSets.count;
+		NSMutableArray *outputs = [NSMutableArray arrayWithCapacity:count];
+		NSMutableArray *inputs = [NSMutableArray arrayWithCapacity:count];
+		for (NSUInteger i = 0; i < count; i++) {
+			[outputs addObject:[GPGMemoryStream memoryStream]];
+			// The streams share data, so it's neither copied nor read more than once.
+			[inputs addObject:[GPGMemoryStream memoryStreamForReading:data]];
+		}
+		
+		[self processTo:outputs inputs:inputs withEncryptSignMode:mode recipientSets:recipientSets];
+		
+		processedData = [NSMutableArray arrayWithCapacity:count];
+		for (GPGMemoryStream *output in outputs) {
+			[processedData addObject:[output readAllData]];
+		}
+	} @catch (NSException *e) {
+		processedData = nil;
+		[self handleException:e];
+	} @finally {
+		[self cleanAfterOperation];
+	}
+	
+	[self operationDidFinishWithReturnValue:processedData];
+	return processedData;
+}
+
+- (void)processTo:(NSArray <GPGStream *> *)outputs data:(GPGStream *)input withEncryptSignMode:(GPGEncryptSignMode)mode recipientSets:(NSArray <NSObject <EnumerationList> *> *)recipientSets {
+	if (async && !asyncStarted) {
+		asyncStarted = YES;
+		[asyncProxy processTo:outputs data:input withEncryptSignMode:mode recipientSets:recipientSets];
+		return;
+	}
+	
+	@try {
+		[self operationDidStart];
+		// Only a few gpgs run at a time, so the input is read once into a spool, which every gpg reads on its own.
+		GPGStreamSpool *spool = [GPGStreamSpool spoolWithStream:input];
+		NSMutableArray *inputs = [NSMutableArray arrayWithCapacity:recipientSets.count];
+		for (NSUInteger i = 0; i < recipientSets.count; i++) {
+			[inputs addObject:[spool readingStream]];
+		}
+		[self processTo:outputs inputs:inputs withEncryptSignMode:mode recipientSets:recipientSets];
+	} @catch (NSException *e) {
+		[self handleException:e];
+	} @finally {
+		[self cleanAfterOperation];
+	}
+	
+	[self operationDidFinishWithReturnValue:nil];
+}
+
+- (void)processTo:(NSArray <GPGStream *> *)outputs inputs:(NSArray <GPGStream *> *)inputs withEncryptSignMode:(GPGEncryptSignMode)mode recipientSets:(NSArray <NSObject <EnumerationList> *> *)recipientSets {
+	if ((mode & GPGEncryptFlags) == 0 || (mode & GPGSeparateSign)) {
+		[NSException raise:NSInvalidArgumentException format:@"Unsupported mode: %i!", mode];
+	}
+	if (outputs.count != recipientSets.count) {
+		[NSException raise:NSInvalidArgumentException format:@"%lu outputs for %lu recipient sets!", (unsigned long)outputs.count, (unsigned long)recipientSets.count];
+	}
+	
+	GPGConcurrentTaskDelegate *taskDelegate = [[[GPGConcurrentTaskDelegate alloc] initWithController:self] autorelease];
+	
+	// The arguments are added to self.gpgTask, so all tasks are created here before any is started.
+	NSMutableArray *tasks = [NSMutableArray arrayWithCapacity:recipientSets.count];
+	[recipientSets enumerateObjectsUsingBlock:^(NSObject <EnumerationList> *recipients, NSUInteger idx, BOOL *stop) {
+		self.gpgTask = [GPGTask gpgTask];
+		gpgTask.batchMode = self.batchMode;
+		[self addArgumentsForOptions];
+		[self addArgumentsForKeyserver];
+		gpgTask.userInfo = [NSDictionary dictionaryWithObject:[GPGTaskOrder orderWithNoToAll] forKey:@"order"];
+		[self addArgumentsForComments];
+		[self addArgumentsForSignerKeys];
+		[self addArgumentsForEncryptMode:mode recipients:recipients hiddenRecipients:nil];
+		[self addArgumentsForSignMode:mode];
+		if (self.forceFilename) {
+			[gpgTask addArgument:@"--set-filename"];
+			[gpgTask addArgument:self.forceFilename];
+		}
+		gpgTask.outStream = outputs[idx];
+		[gpgTask setInput:inputs[idx]];
+		// GPGTask reads the timeout of its delegate only if it's a GPGController.
+		gpgTask.timeout = timeout;
+		[taskDelegate addTask:gpgTask];
+		[tasks addObject:gpgTask];
+	}];
+	
+	@synchronized (self) {
+		concurrentTasks = [tasks retain];
+	}
+	
+	NSMutableArray *exceptions = [NSMutableArray array];
+	dispatch_semaphore_t slots = dispatch_semaphore_create(MAX_CONCURRENT_PROCESS_TASKS);
+	dispatch_group_t group = dispatch_group_create();
+	dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	
+	for (NSUInteger i = 0; i < tasks.count; i++) {
+		dispatch_semaphore_wait(slots, DISPATCH_TIME_FOREVER);
+		GPGTask *task = tasks[i];
+		GPGStream *input = inputs[i];
+		dispatch_group_async(group, queue, ^{
+			@autoreleasepool {
+				@try {
+					if (canceled) {
+						return;
+					}
+					[task start];
+					// The status FAILURE is issued, whenever a sign or encrypt operation failed.
+					if (task.statusDict[@"FAILURE"]) {
+						@throw [GPGException exceptionWithReason:localizedLibmacgpgString(@"Encrypt/sign failed!") gpgTask:task];
+					}
+				} @catch (NSException *exception) {
+					@synchronized (exceptions) {
+						[exceptions addObject:exception];
+					}
+				} @finally {
+					// Don't keep a descriptor for every finished task.
+					[input close];
+					dispatch_semaphore_signal(slots);
+				}
+			}
+		});
+	}
+	
+	dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+	dispatch_release(group);
+	dispatch_release(slots);
+	
+	@synchronized (self) {
+		[concurrentTasks release];
+		concurrentTasks = nil;
+	}
+	
+	cancelCheck;
+	if (exceptions.count > 0) {
+		@throw exceptions[0];
+	}
+}
+
+- (void)addArgumentsForEncryptMode:(GPGEncryptSignMode)mode recipients:(NSObject<EnumerationList> *)recipients hiddenRecipients:(NSObject<EnumerationList> *)hiddenRecipients {
+	if (mode & GPGPublicKeyEncrypt) {
+		[gpgTask addArgument:@"--encrypt"];
+		if ([recipients count] + [hiddenRecipients count] == 0) {
+			[NSException raise:NSInvalidArgumentException format:@"No recipient specified!"];
+		}
+		
+		Class gpgKeyClass = [GPGKey class];
+		
+		for (GPGKey *recipient in recipients) {
+			[gpgTask addArgument:@"--recipient"];
+			
+			if ([recipient isKindOfClass:gpgKeyClass] && recipient.primaryKey != recipient) {
+				// Is a subkey. Force gpg to use exact this subkey.
+				[gpgTask addArgument:[NSString stringWithFormat:@"%@!", recipient.description]];
+			} else {
+				[gpgTask addArgument:recipient.description];
+			}
+		}
+		for (GPGKey *recipient in hiddenRecipients) {
+			[gpgTask addArgument:@"--hidden-recipient"];
+			
+			if ([recipient isKindOfClass:gpgKeyClass] && recipient.primaryKey != recipient) {
+				// Is a subkey. Force gpg to use exact this subkey.
+				[gpgTask addArgument:[NSString stringWithFormat:@"%@!", recipient.description]];
+			} else {
+				[gpgTask addArgument:recipient.description];
+			}
+		}
+	}
+	if (mode & GPGSymetricEncrypt) {
+		[gpgTask addArgument:@"--symmetric"];
+	}
+}
+
+- (void)addArgumentsForSignMode:(GPGEncryptSignMode)mode {
+	switch (mode & GPGSignFlags & ~GPGSeparateSign) {
+		case GPGSign:
+			[gpgTask addArgument:@"--sign"];
+			break;
+		case GPGClearSign:
+			[gpgTask addArgument:@"--clearsign"];
+			break;
+		case GPGDetachedSign:
+			[gpgTask addArgument:@"--detach-sign"];
+			break;
+		case 0:
+			if (mode & GPGSeparateSign) {
+				[gpgTask addArgument:@"--sign"];
+			}
+			break;
+		default:			
+			[NSException raise:NSInvalidArgumentException format:@"Unknown sign mode: %i!", mode & GPGSignFlags];
+			break;
+	}
+}
+
+// A task signing input, for GPGSeparateSign with encryption. The arguments are the same, as if
+// processTo:data:withEncryptSignMode: was called for signing only.
+- (GPGTask *)separateSignTaskWithMode:(GPGEncryptSignMode)mode input:(GPGStream *)input {
+	GPGTask *encryptTask = [[gpgTask retain] autorelease];
+	
+	self.gpgTask = [GPGTask gpgTask];
+	GPGTask *signTask = [[gpgTask retain] autorelease];
+	gpgTask.batchMode = self.batchMode;
+	[self addArgumentsForOptions];
+	[self addArgumentsForKeyserver];
+	gpgTask.userInfo = [NSDictionary dictionaryWithObject:[GPGTaskOrder orderWithNoToAll] forKey:@"order"];
+	[self addArgumentsForComments];
+	[self addArgumentsForSignerKeys];
+	[self addArgumentsForSignMode:mode];
+	if (self.forceFilename) {
+		[gpgTask addArgument:@"--set-filename"];
+		[gpgTask addArgument:self.forceFilename];
+	}
+	[gpgTask setInput:input];
+	
+	self.gpgTask = encryptTask;
+	return signTask;
+}
+
 - (NSData *)decryptData:(NSData *)data {
 	if (async && !asyncStarted) {
 		asyncStarted = YES;
@@ -683,10 +1037,9 @@ BOOL gpgConfigReaded = NO;
 		if (originalInput) {
 			
 			
-			NSString *tempDir = [NSTemporaryDirectory() stringByAppendingPathComponent:@"org.gpgtools.libmacgpg"];
-			NSError *theError = nil;
-			if (![[NSFileManager defaultManager] createDirectoryAtPath:tempDir withIntermediateDirectories:YES attributes:nil error:&theError]) {
-				[NSException raise:NSGenericException format:@"createDirectory failed: %@", theError.localizedDescription];
+			NSString *tempDir = [GPGTaskLaunchContext currentContext].tempDir;
+			if (!tempDir) {
+				[NSException raise:NSGenericException format:@"createDirectory failed: %@", [NSTemporaryDirectory() stringByAppendingPathComponent:@"org.gpgtools.libmacgpg"]];
 			}
 
 			NSString *guid = [NSProcessInfo processInfo].globallyUniqueString ;
@@ -1420,48 +1773,37 @@ BOOL gpgConfigReaded = NO;
 		return nil;
 	}
 	@try {
-		
-		
-        NSData *dataToCheck = data;
-        NSSet *keys = nil;
+		// Only the start of the data is decoded, to find out what it is. Armored data is passed to gpg as it is.
+		NSData *dataToCheck = data;
 		int i = 3; // Max 3 loops.
-        
-        while (dataToCheck.length > 0 && i-- > 0) {
+		
+		while (dataToCheck.length > 0 && i-- > 0) {
 			NSData *unchangedData = dataToCheck;
-			BOOL encrypted = NO;
-
-			NSData *tempData = dataToCheck;
-			if (tempData.isArmored) {
-				GPGUnArmor *unArmor = [GPGUnArmor unArmorWithGPGStream:[GPGMemoryStream memoryStreamForReading:tempData]];
-				tempData = [unArmor decodeAll];
-			}
-            keys = [self keysInExportedData:tempData encrypted:&encrypted];
-
-            if (keys.count > 0) {
-                data = tempData;
-                break;
-            } else if (encrypted) {
-				// Decrypt to allow import of encrypted keys.
-				dataToCheck = [self decryptData:dataToCheck];
-				if (dataToCheck.isArmored) {
-					GPGUnArmor *unArmor = [GPGUnArmor unArmorWithGPGStream:[GPGMemoryStream memoryStreamForReading:dataToCheck]];
-					dataToCheck = [unArmor decodeAll];
-				}
-			} else if (dataToCheck.length > 4 && memcmp(dataToCheck.bytes, "{\\rtf", 4) == 0) {
+			
+			if (dataToCheck.length > 4 && memcmp(dataToCheck.bytes, "{\\rtf", 4) == 0) {
 				// Data is RTF encoded.
 				
 				//Get keys from RTF data.
-				dataToCheck = [[[[NSAttributedString alloc] initWithData:data options:@{} documentAttributes:nil error:nil] string] dataUsingEncoding:NSUTF8StringEncoding];
-				if (dataToCheck.isArmored) {
-					GPGUnArmor *unArmor = [GPGUnArmor unArmorWithGPGStream:[GPGMemoryStream memoryStreamForReading:dataToCheck]];
-					dataToCheck = [unArmor decodeAll];
+				dataToCheck = [[[[NSAttributedString alloc] initWithData:dataToCheck options:@{} documentAttributes:nil error:nil] string] dataUsingEncoding:NSUTF8StringEncoding];
+			} else {
+				GPGPacketTag tag = firstPacketTagOfData(dataToCheck);
+				if (tag == GPGPublicKeyEncryptedSessionKeyPacketTag || tag == GPGSymmetricEncryptedSessionKeyPacketTag) {
+					// Decrypt to allow import of encrypted keys.
+					dataToCheck = [self decryptData:dataToCheck];
 				}
 			}
-			if (unchangedData == dataToCheck) {
+			if (unchangedData == dataToCheck || dataToCheck.length == 0) {
 				break;
 			}
-        }
+			data = dataToCheck;
+		}
 		
+		// The keys are only needed before the import, to register the undo. Otherwise gpg reports them.
+		NSSet *keys = nil;
+		BOOL registerUndo = [undoManager isUndoRegistrationEnabled];
+		if (registerUndo) {
+			keys = [self fingerprintsOfKeysInImportData:data];
+		}
 		
 		
 		//TODO: Uncomment the following lines when keysInExportedData: fully works!
@@ -1475,17 +1817,19 @@ BOOL gpgConfigReaded = NO;
 		
 		//GPGTaskOrder *order = [GPGTaskOrder orderWithNoToAll];
 		
+		NSMutableArray *importArguments = [NSMutableArray arrayWithObject:@"--import"];
+		if (fullImport) {
+			[importArguments addObject:@"--import-options"];
+			[importArguments addObject:@"import-local-sigs"];
+			[importArguments addObject:@"--allow-non-selfsigned-uid"];
+			[importArguments addObject:@"--allow-weak-digest-algos"];
+		}
+		
 		self.gpgTask = [GPGTask gpgTask];
 		[self addArgumentsForOptions];
 		//gpgTask.userInfo = [NSDictionary dictionaryWithObject:order forKey:@"order"]; 
 		[gpgTask setInData:data];
-		[gpgTask addArgument:@"--import"];
-		if (fullImport) {
-			[gpgTask addArgument:@"--import-options"];
-			[gpgTask addArgument:@"import-local-sigs"];
-			[gpgTask addArgument:@"--allow-non-selfsigned-uid"];
-			[gpgTask addArgument:@"--allow-weak-digest-algos"];
-		}
+		[gpgTask addArguments:importArguments];
 		
 		
 		[gpgTask start];
@@ -1495,10 +1839,35 @@ BOOL gpgConfigReaded = NO;
 		
 		NSRange range = [statusText rangeOfString:@"[GNUPG:] IMPORT_RES "];
 		
+		if ((range.length == 0 || [statusText characterAtIndex:range.location + range.length] == '0') && data.isArmored) {
+			// gpg is stricter than GPGUnArmor. Try again with the decoded data.
+			// This is the only case, where the data is decoded here.
+			NSData *unArmoredData = [[GPGUnArmor unArmorWithGPGStream:[GPGMemoryStream memoryStreamForReading:data]] decodeAll];
+			if (unArmoredData.length > 0) {
+				if (registerUndo) {
+					// gpg couldn't list the keys in the armored data either.
+					keys = [self fingerprintsOfKeysInImportData:unArmoredData];
+					[self registerUndoForKeys:keys withName:@"Undo_Import"];
+				}
+				
+				self.gpgTask = [GPGTask gpgTask];
+				[self addArgumentsForOptions];
+				[gpgTask setInData:unArmoredData];
+				[gpgTask addArguments:importArguments];
+				[gpgTask start];
+				
+				statusText = gpgTask.statusText;
+				range = [statusText rangeOfString:@"[GNUPG:] IMPORT_RES "];
+			}
+		}
+		
 		if (range.length == 0 || [statusText characterAtIndex:range.location + range.length] == '0') {
 			@throw [GPGException exceptionWithReason:localizedLibmacgpgString(@"Import failed!") gpgTask:gpgTask];
 		}
 		
+		if (!keys) {
+			keys = importedFingerprintsFromStatus(gpgTask.statusDict);
+		}
 		[self keysChanged:keys];
 	} @catch (NSException *e) {
 		[self handleException:e];
@@ -2176,6 +2545,297 @@ BOOL gpgConfigReaded = NO;
 }
 
 
+#pragma mark Key edit transactions
+
+- (void)performKeyEditTransaction:(GPGKeyEditTransaction *)transaction {
+	if (async && !asyncStarted) {
+		asyncStarted = YES;
+		[asyncProxy performKeyEditTransaction:transaction];
+		return;
+	}
+	NSSet *keys = transaction.keys;
+	@try {
+		groupedKeyChange++;
+		[self operationDidStart];
+		[self registerUndoForKeys:keys withName:nil];
+		
+		// Every session changes the keyring files, so the loaded keys can't be used for the indexes afterwards.
+		// The indexes of a key don't change until its user IDs and subkeys are removed at the very end.
+		NSMapTable *indexes = [NSMapTable strongToStrongObjectsMapTable];
+		for (GPGKeyEdit *edit in transaction.edits) {
+			[indexes setObject:[self indexesForKeyEdit:edit] forKey:edit];
+		}
+		
+		for (GPGKey *key in keys) {
+			// Removals of signatures answer a prompt for every signature of the user ID and would also remove
+			// signatures made in the same session. So they get sessions of their own, before the others.
+			// Signatures of every signer key need their own session. The last session also does all other edits.
+			NSMutableArray *signatureEdits = [NSMutableArray array];
+			NSMutableArray *signerKeys = [NSMutableArray array];
+			NSMutableDictionary *signEdits = [NSMutableDictionary dictionary];
+			NSMutableArray *otherEdits = [NSMutableArray array];
+			NSMutableArray *removals = [NSMutableArray array];
+			
+			for (GPGKeyEdit *edit in transaction.edits) {
+				if (![edit.key isEqual:key]) {
+					continue;
+				}
+				switch (edit.kind) {
+					case GPGKeyEditRemoveSignature:
+					case GPGKeyEditRevokeSignature:
+						[signatureEdits addObject:edit];
+						break;
+					case GPGKeyEditSignUserIDs: {
+						NSString *signer = edit.signerKey ? edit.signerKey.description : @"";
+						NSMutableArray *edits = [signEdits objectForKey:signer];
+						if (!edits) {
+							edits = [NSMutableArray array];
+							[signEdits setObject:edits forKey:signer];
+							[signerKeys addObject:signer];
+						}
+						[edits addObject:edit];
+						break; }
+					default:
+						if (edit.removesItem) {
+							[removals addObject:edit];
+						} else {
+							[otherEdits addObject:edit];
+						}
+						break;
+				}
+			}
+			
+			// Remove the item with the highest index first, so the indexes of the others don't change.
+			[removals sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(GPGKeyEdit *edit1, GPGKeyEdit *edit2) {
+				NSUInteger index1 = [[indexes objectForKey:edit1] firstIndex];
+				NSUInteger index2 = [[indexes objectForKey:edit2] firstIndex];
+				return index1 > index2 ? NSOrderedAscending : index1 < index2 ? NSOrderedDescending : NSOrderedSame;
+			}];
+			[otherEdits addObjectsFromArray:removals];
+			
+			
+			for (GPGTaskOrder *order in [self signatureOrdersForKeyEdits:signatureEdits indexes:indexes]) {
+				[self runKeyEditOrder:order ofKey:key signerKey:nil signs:NO addsUserID:NO];
+			}
+			
+			NSString *lastSigner = signerKeys.lastObject;
+			for (NSString *signer in signerKeys) {
+				NSMutableArray *edits = [signEdits objectForKey:signer];
+				if (signer == lastSigner) {
+					[edits addObjectsFromArray:otherEdits];
+				}
+				[self runKeyEdits:edits ofKey:key signerKey:signer.length > 0 ? signer : nil defaultBoolAnswer:YesToAll indexes:indexes];
+			}
+			if (!lastSigner && otherEdits.count > 0) {
+				[self runKeyEdits:otherEdits ofKey:key signerKey:nil defaultBoolAnswer:YesToAll indexes:indexes];
+			}
+		}
+	} @catch (NSException *e) {
+		[self handleException:e];
+	} @finally {
+		groupedKeyChange--;
+		[self keysChanged:keys];
+		[self cleanAfterOperation];
+	}
+	
+	[self operationDidFinishWithReturnValue:nil];
+}
+
+- (void)runKeyEdits:(NSArray *)edits ofKey:(GPGKey *)key signerKey:(NSString *)signerKey defaultBoolAnswer:(BoolAnswer)defaultBoolAnswer indexes:(NSMapTable *)indexes {
+	GPGTaskOrder *order = defaultBoolAnswer == NoToAll ? [GPGTaskOrder orderWithNoToAll] : [GPGTaskOrder orderWithYesToAll];
+	BOOL signs = NO;
+	BOOL addsUserID = NO;
+	
+	for (GPGKeyEdit *edit in edits) {
+		signs |= edit.kind == GPGKeyEditSignUserIDs;
+		addsUserID |= edit.kind == GPGKeyEditAddUserID;
+		[self addCommandsForKeyEdit:edit indexes:[indexes objectForKey:edit] toOrder:order];
+	}
+	[order addCmd:@"save\n" prompt:@"keyedit.prompt"];
+	
+	[self runKeyEditOrder:order ofKey:key signerKey:signerKey signs:signs addsUserID:addsUserID];
+}
+
+- (void)runKeyEditOrder:(GPGTaskOrder *)order ofKey:(GPGKey *)key signerKey:(NSString *)signerKey signs:(BOOL)signs addsUserID:(BOOL)addsUserID {
+	self.gpgTask = [GPGTask gpgTask];
+	if (addsUserID) {
+		[gpgTask addArgument:@"--allow-freeform-uid"];
+	}
+	[self addArgumentsForOptions];
+	gpgTask.userInfo = [NSDictionary dictionaryWithObject:order forKey:@"order"];
+	if (signerKey) {
+		[gpgTask addArgument:@"-u"];
+		[gpgTask addArgument:signerKey];
+	}
+	if (signs) {
+		[gpgTask addArgument:@"--ask-cert-expire"];
+		[gpgTask addArgument:@"--no-ask-cert-level"];
+	}
+	[gpgTask addArgument:@"--edit-key"];
+	[gpgTask addArgument:key.fingerprint];
+	
+	if ([gpgTask start] != 0) {
+		@throw [GPGException exceptionWithReason:localizedLibmacgpgString(@"Edit key failed!") gpgTask:gpgTask];
+	}
+}
+
+// The indexes of the user IDs or subkeys of edit, as used by --edit-key.
+- (NSIndexSet *)indexesForKeyEdit:(GPGKeyEdit *)edit {
+	GPGKey *key = edit.key;
+	NSMutableIndexSet *indexes = [NSMutableIndexSet indexSet];
+	
+	for (GPGUserID *userID in edit.userIDs) {
+		NSInteger uid = [self indexOfUserID:userID.hashID fromKey:key];
+		if (uid <= 0) {
+			@throw [GPGException exceptionWithReason:localizedLibmacgpgString(@"UserID not found!") userInfo:[NSDictionary dictionaryWithObjectsAndKeys:userID.hashID, @"hashID", key, @"key", nil] errorCode:GPGErrorNoUserID gpgTask:nil];
+		}
+		[indexes addIndex:uid];
+	}
+	for (GPGKey *subkey in edit.subkeys) {
+		NSInteger index = [self indexOfSubkey:subkey fromKey:key];
+		if (index <= 0) {
+			@throw [GPGException exceptionWithReason:localizedLibmacgpgString(@"Subkey not found!") userInfo:[NSDictionary dictionaryWithObjectsAndKeys:subkey, @"subkey", key, @"key", nil] errorCode:GPGErrorSubkeyNotFound gpgTask:nil];
+		}
+		[indexes addIndex:index];
+	}
+	
+	return indexes;
+}
+
+/*
+ * The orders of the sessions, which remove or revoke the signatures of edits. All edits belong to the same key.
+ * delsig and revsig ask for every signature of the selected user ID, so the answers follow the signatures of the
+ * loaded user ID, without the ones removed by an earlier session.
+ * All removals run first, in one session with one delsig per user ID, because a revocation adds a signature
+ * to the user ID, which delsig would ask for too. Every revocation runs in a session of its own.
+ */
+- (NSArray <GPGTaskOrder *> *)signatureOrdersForKeyEdits:(NSArray *)edits indexes:(NSMapTable *)indexes {
+	NSMutableArray *orders = [NSMutableArray array];
+	NSMutableArray *removedSignatures = [NSMutableArray array];
+	NSMutableArray *firstRemovals = [NSMutableArray array]; // The first removal of every user ID.
+	NSMutableSet *userIDsWithRemovals = [NSMutableSet set];
+	
+	for (GPGKeyEdit *edit in edits) {
+		if (edit.kind == GPGKeyEditRemoveSignature) {
+			[removedSignatures addObject:edit.signature];
+			NSString *hashID = [(GPGUserID *)edit.userIDs[0] hashID];
+			if (![userIDsWithRemovals containsObject:hashID]) {
+				[userIDsWithRemovals addObject:hashID];
+				[firstRemovals addObject:edit];
+			}
+		}
+	}
+	
+	if (firstRemovals.count > 0) {
+		GPGTaskOrder *order = [GPGTaskOrder orderWithNoToAll];
+		for (GPGKeyEdit *edit in firstRemovals) {
+			[self addSelectionOfIndexes:[indexes objectForKey:edit] subkeys:NO toOrder:order];
+			[order addCmd:@"delsig\n" prompt:@"keyedit.prompt"];
+			GPGUserID *userID = edit.userIDs[0];
+			for (GPGUserIDSignature *aSignature in userID.signatures) {
+				if ([removedSignatures indexOfObjectIdenticalTo:aSignature] != NSNotFound) {
+					[order addCmd:@"y\n" prompt:@[@"keyedit.delsig.valid", @"keyedit.delsig.invalid", @"keyedit.delsig.unknown"]];
+					if ([[aSignature keyID] isEqualToString:[edit.key.description keyID]]) {
+						[order addCmd:@"y\n" prompt:@"keyedit.delsig.selfsig"];
+					}
+				} else {
+					[order addCmd:@"n\n" prompt:@[@"keyedit.delsig.valid", @"keyedit.delsig.invalid", @"keyedit.delsig.unknown"]];
+				}
+			}
+		}
+		[order addCmd:@"save\n" prompt:@"keyedit.prompt"];
+		[orders addObject:order];
+	}
+	
+	for (GPGKeyEdit *edit in edits) {
+		if (edit.kind != GPGKeyEditRevokeSignature) {
+			continue;
+		}
+		GPGTaskOrder *order = [GPGTaskOrder orderWithNoToAll];
+		[self addSelectionOfIndexes:[indexes objectForKey:edit] subkeys:NO toOrder:order];
+		[order addCmd:@"revsig\n" prompt:@"keyedit.prompt"];
+		GPGUserID *userID = edit.userIDs[0];
+		for (GPGUserIDSignature *aSignature in userID.signatures) {
+			if (aSignature.revocation == NO && aSignature.primaryKey.secret && [removedSignatures indexOfObjectIdenticalTo:aSignature] == NSNotFound) {
+				[order addCmd:aSignature == edit.signature ? @"y\n" : @"n\n" prompt:@"ask_revoke_sig.one"];
+			}
+		}
+		[order addCmd:@"y\n" prompt:@"ask_revoke_sig.okay" optional:YES];
+		[self addRevocationReason:edit.reason description:edit.reasonDescription toOrder:order];
+		[order addCmd:@"save\n" prompt:@"keyedit.prompt"];
+		[orders addObject:order];
+	}
+	
+	return orders;
+}
+
+- (void)addSelectionOfIndexes:(NSIndexSet *)indexes subkeys:(BOOL)subkeys toOrder:(GPGTaskOrder *)order {
+	// The selection of the previous edit is still active.
+	[order addCmd:@"uid 0\n" prompt:@"keyedit.prompt"];
+	[order addCmd:@"key 0\n" prompt:@"keyedit.prompt"];
+	
+	NSString *format = subkeys ? @"key %lu\n" : @"uid %lu\n";
+	[indexes enumerateIndexesUsingBlock:^(NSUInteger idx, BOOL *stop) {
+		[order addCmd:[NSString stringWithFormat:format, (unsigned long)idx] prompt:@"keyedit.prompt"];
+	}];
+}
+
+- (void)addCommandsForKeyEdit:(GPGKeyEdit *)edit indexes:(NSIndexSet *)indexes toOrder:(GPGTaskOrder *)order {
+	[self addSelectionOfIndexes:indexes subkeys:edit.subkeys.count > 0 toOrder:order];
+	
+	switch (edit.kind) {
+		case GPGKeyEditSignUserIDs:
+			[order addCmd:edit.local ? @"lsign\n" : @"sign\n" prompt:@"keyedit.prompt"];
+			[order addCmd:@"n\n" prompt:@"sign_uid.expire" optional:YES];
+			[order addCmd:[self dateToString:edit.expirationDate] prompt:@"siggen.valid" optional:YES];
+			break;
+		case GPGKeyEditRemoveSignature:
+		case GPGKeyEditRevokeSignature:
+			// Run in sessions of their own, see signatureOrdersForKeyEdits:indexes:.
+			break;
+		case GPGKeyEditAddUserID:
+			[order addCmd:@"adduid\n" prompt:@"keyedit.prompt"];
+			[order addCmd:edit.name prompt:@"keygen.name"];
+			[order addCmd:edit.email prompt:@"keygen.email"];
+			[order addCmd:edit.comment prompt:@"keygen.comment"];
+			break;
+		case GPGKeyEditRemoveUserID:
+			[order addCmd:@"deluid\n" prompt:@"keyedit.prompt"];
+			break;
+		case GPGKeyEditRevokeUserID:
+			[order addCmd:@"revuid\n" prompt:@"keyedit.prompt"];
+			[self addRevocationReason:edit.reason description:edit.reasonDescription toOrder:order];
+			break;
+		case GPGKeyEditSetPrimaryUserID:
+			[order addCmd:@"primary\n" prompt:@"keyedit.prompt"];
+			break;
+		case GPGKeyEditRemoveSubkey:
+			[order addCmd:@"delkey\n" prompt:@"keyedit.prompt"];
+			break;
+		case GPGKeyEditRevokeSubkey:
+			[order addCmd:@"revkey\n" prompt:@"keyedit.prompt"];
+			[self addRevocationReason:edit.reason description:edit.reasonDescription toOrder:order];
+			break;
+		case GPGKeyEditSetExpirationDate:
+			[order addCmd:@"expire\n" prompt:@"keyedit.prompt"];
+			[order addCmd:[self dateToString:edit.expirationDate] prompt:@"keygen.valid"];
+			break;
+	}
+}
+
+- (void)addRevocationReason:(int)reason description:(NSString *)description toOrder:(GPGTaskOrder *)order {
+	[order addInt:reason prompt:@"ask_revocation_reason.code" optional:YES];
+	if (description) {
+		NSArray *lines = [description componentsSeparatedByString:@"\n"];
+		for (NSString *line in lines) {
+			[order addCmd:line prompt:@"ask_revocation_reason.text" optional:YES];
+		}
+	}
+	[order addCmd:@"\n" prompt:@"ask_revocation_reason.text" optional:YES];
+	[order addCmd:@"y\n" prompt:@"ask_revocation_reason.okay" optional:YES];
+}
+
+
 #pragma mark Working with keyserver
 
 - (NSString *)receiveKeysFromServer:(NSObject <EnumerationList> *)keys {
@@ -3053,7 +3713,36 @@ BOOL gpgConfigReaded = NO;
 	return [GPGTaskHelper isPassphraseInGPGAgentCache:(NSObject <KeyFingerprint> *)key];
 }
 
+// The key as loaded by a GPGKeyManager for the keyring of this controller, if the keyring files haven't
+// changed since. nil if gpg has to be asked.
+- (GPGKey *)upToDateKeyForKey:(NSObject <KeyFingerprint> *)key {
+	GPGKeyManager *keyManager = nil;
+	if ([key isKindOfClass:[GPGKey class]]) {
+		keyManager = [(GPGKey *)key primaryKey].keyManager;
+	}
+	if (!keyManager) {
+		keyManager = [GPGKeyManager sharedInstance];
+	}
+	
+	NSString *defaultHome = [[GPGOptions sharedOptions] gpgHome];
+	NSString *managerHome = keyManager.homedir ? keyManager.homedir : defaultHome;
+	NSString *controllerHome = gpgHome ? gpgHome : defaultHome;
+	if (![[managerHome stringByStandardizingPath] isEqualToString:[controllerHome stringByStandardizingPath]]) {
+		return nil;
+	}
+	
+	return [keyManager upToDateKeyWithFingerprint:[key description]];
+}
+
 - (NSInteger)indexOfUserID:(NSString *)hashID fromKey:(NSObject <KeyFingerprint> *)key {
+	GPGKey *loadedKey = [self upToDateKeyForKey:key];
+	if (loadedKey) {
+		NSUInteger index = [loadedKey.userIDs indexOfObjectPassingTest:^BOOL(GPGUserID *userID, NSUInteger idx, BOOL *stop) {
+			return [userID.hashID isEqualToString:hashID];
+		}];
+		return index == NSNotFound ? 0 : index + 1;
+	}
+	
 	self.gpgTask = [GPGTask gpgTask];
 	[self addArgumentsForOptions];
 	[gpgTask addArgument:@"-k"];
@@ -3091,6 +3780,18 @@ BOOL gpgConfigReaded = NO;
 		}
 		[hashIDs addObject:userID.hashID];
 	}
+	
+	NSMutableIndexSet *indexSet = [[NSMutableIndexSet new] autorelease];
+	
+	GPGKey *loadedKey = [self upToDateKeyForKey:[(GPGUserID *)userIDs[0] primaryKey]];
+	if (loadedKey) {
+		[loadedKey.userIDs enumerateObjectsUsingBlock:^(GPGUserID *userID, NSUInteger idx, BOOL *stop) {
+			if ([hashIDs containsObject:userID.hashID]) {
+				[indexSet addIndex:idx + 1];
+			}
+		}];
+		return indexSet;
+	}
 
 	
 	self.gpgTask = [GPGTask gpgTask];
@@ -3103,8 +3804,6 @@ BOOL gpgConfigReaded = NO;
 	NSString *outText = gpgTask.outText;
 	NSArray *lines = [outText componentsSeparatedByString:@"\n"];
 	
-	NSMutableIndexSet *indexSet = [[NSMutableIndexSet new] autorelease];
-	
 	NSUInteger index = 0;
 	for (NSString *line in lines) {
 		if ([line hasPrefix:@"uid:"] || [line hasPrefix:@"uat:"]) {
@@ -3124,6 +3823,15 @@ BOOL gpgConfigReaded = NO;
 
 
 - (NSInteger)indexOfSubkey:(NSObject <KeyFingerprint> *)subkey fromKey:(NSObject <KeyFingerprint> *)key {
+	GPGKey *loadedKey = [self upToDateKeyForKey:key];
+	if (loadedKey) {
+		NSString *description = [subkey description];
+		NSUInteger index = [loadedKey.subkeys indexOfObjectPassingTest:^BOOL(GPGKey *aSubkey, NSUInteger idx, BOOL *stop) {
+			return [aSubkey.fingerprint isEqualToString:description] || [aSubkey.keyID isEqualToString:description];
+		}];
+		return index == NSNotFound ? 0 : index + 1;
+	}
+	
 	self.gpgTask = [GPGTask gpgTask];
 	[self addArgumentsForOptions];
 	[gpgTask addArgument:@"-k"];
@@ -3156,12 +3864,48 @@ BOOL gpgConfigReaded = NO;
 
 - (NSSet *)keysInExportedData:(NSData *)data encrypted:(BOOL *)encrypted {
 	// Returns a set of fingerprints and keyIDs of keys and key-parts (like signatures) in the data.
+	return [self keysInStream:[GPGMemoryStream memoryStreamForReading:data] encrypted:encrypted];
+}
+
+- (NSSet *)fingerprintsOfKeysInImportData:(NSData *)data {
+	// gpg lists the keys without importing them. It reads armored data itself, so nothing is decoded here.
+	GPGTask *oldGPGTask = self.gpgTask;
+	self.gpgTask = [GPGTask gpgTask];
+	[self addArgumentsForOptions];
+	[gpgTask setInData:data];
+	[gpgTask addArgument:@"--import-options"];
+	[gpgTask addArgument:@"show-only"];
+	[gpgTask addArgument:@"--import"];
 	
+	[gpgTask start];
+	
+	NSMutableSet *fingerprints = [NSMutableSet set];
+	NSArray *lines = [gpgTask.outText componentsSeparatedByString:@"\n"];
+	BOOL isPrimaryKey = NO;
+	for (NSString *line in lines) {
+		if ([line hasPrefix:@"pub:"] || [line hasPrefix:@"sec:"]) {
+			isPrimaryKey = YES;
+		} else if ([line hasPrefix:@"fpr:"]) {
+			NSArray *parts = [line componentsSeparatedByString:@":"];
+			if (isPrimaryKey && parts.count >= 10) {
+				[fingerprints addObject:parts[9]];
+			}
+			isPrimaryKey = NO;
+		} else if (![line hasPrefix:@"uid:"] && ![line hasPrefix:@"uat:"]) {
+			isPrimaryKey = NO;
+		}
+	}
+	
+	self.gpgTask = oldGPGTask;
+	return fingerprints;
+}
+
+- (NSSet *)keysInStream:(GPGStream *)stream encrypted:(BOOL *)encrypted {
+	// Reads the packets one by one, the stream isn't copied.
 	NSMutableSet *keys = [NSMutableSet set];
 	NSMutableSet *keyIDs = [NSMutableSet set];
 
 	
-	GPGMemoryStream *stream = [GPGMemoryStream memoryStreamForReading:data];
 	GPGPacketParser *parser = [GPGPacketParser packetParserWithStream:stream];
 	
 	GPGPacket *packet;
@@ -3297,13 +4041,13 @@ BOOL gpgConfigReaded = NO;
 		if (fingerprint.length == 16) { // KeyID
 			key = [keyManager.keysByKeyID objectForKey:fingerprint];
 		} else { // Fingerprint
-			key = [keyManager.allKeysAndSubkeys member:fingerprint];
+			key = [keyManager.keysByFingerprint objectForKey:fingerprint];
 			
 			// If no key is available, but components[0] is a fingerprint it means that our
 			// list of keys is outdated. In that case, the specific key is reloaded.
 			if(!key && components[0].length >= 32) {
 				[keyManager loadKeys:[NSSet setWithObject:fingerprint] fetchSignatures:NO fetchUserAttributes:NO];
-				key = [keyManager.allKeysAndSubkeys member:fingerprint];
+				key = [keyManager.keysByFingerprint objectForKey:fingerprint];
 			}
 		}
 		
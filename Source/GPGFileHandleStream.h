@@ -0,0 +1,35 @@
+//
+//  GPGFileHandleStream.h
+//  Libmacgpg
+//
+
+#import <Libmacgpg/GPGStream.h>
+
+// a sequential stream atop a file handle, e.g. one end of a pipe.
+// the stream is either readable or writeable and can't seek,
+// so readAllData is only possible before anything was read
+@interface GPGFileHandleStream : GPGStream {
+    NSFileHandle *_fileHandle;
+    BOOL _forWriting;
+    unsigned long long _length;
+    NSUInteger _offset;
+
+    // for peekByte and readByte
+    NSData *_cacheData;
+    const UInt8 *_cacheBytes;
+    NSUInteger _cacheLocation;
+    NSUInteger _cacheAvailableBytes;
+}
+
+// return a new, autoreleased stream reading from fileHandle.
+// length is only a hint, returned by -length (e.g. for progress), pass 0 if unknown
++ (id)streamForReadingFromFileHandle:(NSFileHandle *)fileHandle length:(unsigned long long)length;
+// return a new, autoreleased stream writing to fileHandle
++ (id)streamForWritingToFileHandle:(NSFileHandle *)fileHandle;
+
+- (id)initForReadingFromFileHandle:(NSFileHandle *)fileHandle length:(unsigned long long)length;
+- (id)initForWritingToFileHandle:(NSFileHandle *)fileHandle;
+
+@property (nonatomic, readonly) NSFileHandle *fileHandle;
+
+@end
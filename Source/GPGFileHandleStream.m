@@ -0,0 +1,172 @@
+//
+//  GPGFileHandleStream.m
+//  Libmacgpg
+//
+
+#import "GPGFileHandleStream.h"
+
+static const NSUInteger kCacheSize = 1024;
+
+
+@implementation GPGFileHandleStream
+@synthesize fileHandle = _fileHandle;
+
+- (void)dealloc
+{
+    [_fileHandle release];
+    [_cacheData release];
+    [super dealloc];
+}
+
++ (id)streamForReadingFromFileHandle:(NSFileHandle *)fileHandle length:(unsigned long long)length {
+    return [[[self alloc] initForReadingFromFileHandle:fileHandle length:length] autorelease];
+}
+
++ (id)streamForWritingToFileHandle:(NSFileHandle *)fileHandle {
+    return [[[self alloc] initForWritingToFileHandle:fileHandle] autorelease];
+}
+
+- (id)initForReadingFromFileHandle:(NSFileHandle *)fileHandle length:(unsigned long long)length {
+	self = [super init];
+	if (!self) {
+		return nil;
+	}
+	if (!fileHandle) {
+		[self release];
+		return nil;
+	}
+
+	_fileHandle = [fileHandle retain];
+	_length = length;
+
+	return self;
+}
+
+- (id)initForWritingToFileHandle:(NSFileHandle *)fileHandle {
+	self = [super init];
+	if (!self) {
+		return nil;
+	}
+	if (!fileHandle) {
+		[self release];
+		return nil;
+	}
+
+	_fileHandle = [fileHandle retain];
+	_forWriting = YES;
+
+	return self;
+}
+
+- (void)writeData:(NSData *)data {
+	if (!_forWriting) {
+        @throw [NSException exceptionWithName:@"InvalidOperationException" reason:@"stream is readable" userInfo:nil];
+	}
+	[_fileHandle writeData:data];
+	_length += data.length;
+	_offset += data.length;
+}
+
+- (void)checkReadable {
+	if (_forWriting) {
+        @throw [NSException exceptionWithName:@"InvalidOperationException" reason:@"stream is writeable" userInfo:nil];
+	}
+}
+
+// returns the bytes which were already read into the cache, but not yet consumed
+- (NSData *)takeCachedData {
+	if (_cacheAvailableBytes == 0) {
+		return nil;
+	}
+	NSData *data = [_cacheData subdataWithRange:NSMakeRange(_cacheLocation, _cacheAvailableBytes)];
+	_cacheAvailableBytes = 0;
+	return data;
+}
+
+- (NSData *)readDataToEndOfStream {
+	[self checkReadable];
+
+	NSData *cachedData = [self takeCachedData];
+	NSData *data = [_fileHandle readDataToEndOfFile];
+	if (cachedData) {
+		NSMutableData *mutableData = [NSMutableData dataWithData:cachedData];
+		[mutableData appendData:data];
+		data = mutableData;
+	}
+	_offset += data.length;
+	return data;
+}
+
+- (NSData *)readDataOfLength:(NSUInteger)length {
+	[self checkReadable];
+
+	NSData *data = [self takeCachedData];
+	if (data.length > length) {
+		// Put back what wasn't requested.
+		_cacheLocation = _cacheData.length - (data.length - length);
+		_cacheAvailableBytes = data.length - length;
+		data = [data subdataWithRange:NSMakeRange(0, length)];
+	} else if (data.length < length) {
+		NSData *readData = [_fileHandle readDataOfLength:length - data.length];
+		if (data) {
+			NSMutableData *mutableData = [NSMutableData dataWithData:data];
+			[mutableData appendData:readData];
+			data = mutableData;
+		} else {
+			data = readData;
+		}
+	}
+	_offset += data.length;
+	return data;
+}
+
+- (NSData *)readAllData {
+	if (_offset != 0) {
+		@throw [NSException exceptionWithName:@"InvalidOperationException" reason:@"stream can't seek" userInfo:nil];
+	}
+	return [self readDataToEndOfStream];
+}
+
+- (BOOL)fillCache {
+	if (_cacheAvailableBytes > 0) {
+		return YES;
+	}
+	[_cacheData release];
+	_cacheData = [[_fileHandle readDataOfLength:kCacheSize] retain];
+	_cacheBytes = _cacheData.bytes;
+	_cacheLocation = 0;
+	_cacheAvailableBytes = _cacheData.length;
+	return _cacheAvailableBytes > 0;
+}
+
+- (NSInteger)readByte {
+	[self checkReadable];
+	if (![self fillCache]) {
+		return EOF;
+	}
+	_offset++;
+	_cacheAvailableBytes--;
+	return _cacheBytes[_cacheLocation++];
+}
+
+- (char)peekByte {
+	[self checkReadable];
+	if (![self fillCache]) {
+		return 0;
+	}
+	return (char)_cacheBytes[_cacheLocation];
+}
+
+- (void)close {
+	[_fileHandle closeFile];
+}
+
+- (NSUInteger)offset {
+	return _offset;
+}
+
+- (unsigned long long)length {
+	return _length;
+}
+
+@end
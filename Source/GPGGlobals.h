@@ -260,6 +260,9 @@ NSString *localizedLibmacgpgString(NSString *key);
 
 
 int hexToByte (const char *text);
+// Decodes gpg's C-style escapes ("\\x3a" -> ":") of length bytes into unescapedText, which must have room for length bytes.
+// Returns the number of bytes written. No terminating NUL is added.
+NSUInteger unescapeBytes(const char *escapedText, NSUInteger length, char *unescapedText);
 NSString* bytesToHexString(const uint8_t *bytes, NSUInteger length);
 NSSet *importedFingerprintsFromStatus(NSDictionary *statusDict);
 void *lm_memmem(const void *big, size_t big_len, const void *little, size_t little_len);
@@ -300,60 +300,13 @@ static const UInt32 crcTable[256] = {
 	//Wandelt "\\t" -> "\t", "\\x3a" -> ":" usw.
 	
 	const char *escapedText = [self UTF8String];
-	char *unescapedText = malloc(strlen(escapedText) + 1);
+	NSUInteger length = strlen(escapedText);
+	char *unescapedText = malloc(length + 1);
 	if (!unescapedText) {
 		return nil;
 	}
-	char *unescapedTextPos = unescapedText;
 	
-	while (*escapedText) {
-		if (*escapedText == '\\') {
-			escapedText++;
-			switch (*escapedText) {
-#define DECODE_ONE(match, result) \
-case match: \
-escapedText++; \
-*(unescapedTextPos++) = result; \
-break;
-					
-					DECODE_ONE ('\'', '\'');
-					DECODE_ONE ('\"', '\"');
-					DECODE_ONE ('\?', '\?');
-					DECODE_ONE ('\\', '\\');
-					DECODE_ONE ('a', '\a');
-					DECODE_ONE ('b', '\b');
-					DECODE_ONE ('f', '\f');
-					DECODE_ONE ('n', '\n');
-					DECODE_ONE ('r', '\r');
-					DECODE_ONE ('t', '\t');
-					DECODE_ONE ('v', '\v');
-					
-				case 'x': {
-					escapedText++;
-					int byte = hexToByte(escapedText);
-					if (byte == -1) {
-						*(unescapedTextPos++) = '\\';
-						*(unescapedTextPos++) = 'x';
-					} else {
-						if (byte == 0) {
-							*(unescapedTextPos++) = '\\';
-							*(unescapedTextPos++) = '0';
-						} else {
-							*(unescapedTextPos++) = (char)byte;
-						}
-						escapedText += 2;
-					}
-					break; }
-				default:
-					*(unescapedTextPos++) = '\\';
-					*(unescapedTextPos++) = *(escapedText++);
-					break;
-			}
-		} else {
-			*(unescapedTextPos++) = *(escapedText++);
-		}
-	}
-	*unescapedTextPos = 0;
+	unescapedText[unescapeBytes(escapedText, length, unescapedText)] = 0;
 	
 	NSString *retString = [NSString stringWithUTF8String:unescapedText];
 	free(unescapedText);
@@ -492,6 +445,61 @@ int hexToByte (const char *text) {
     }
 	return retVal;
 }
+NSUInteger unescapeBytes(const char *escapedText, NSUInteger length, char *unescapedText) {
+	const char *end = escapedText + length;
+	char *unescapedTextPos = unescapedText;
+	
+	while (escapedText < end) {
+		if (*escapedText == '\\' && escapedText + 1 < end) {
+			escapedText++;
+			switch (*escapedText) {
+#define DECODE_ONE(match, result) \
+case match: \
+escapedText++; \
+*(unescapedTextPos++) = result; \
+break;
+					
+					DECODE_ONE ('\'', '\'');
+					DECODE_ONE ('\"', '\"');
+					DECODE_ONE ('\?', '\?');
+					DECODE_ONE ('\\', '\\');
+					DECODE_ONE ('a', '\a');
+					DECODE_ONE ('b', '\b');
+					DECODE_ONE ('f', '\f');
+					DECODE_ONE ('n', '\n');
+					DECODE_ONE ('r', '\r');
+					DECODE_ONE ('t', '\t');
+					DECODE_ONE ('v', '\v');
+#undef DECODE_ONE
+					
+				case 'x': {
+					escapedText++;
+					int byte = end - escapedText >= 2 ? hexToByte(escapedText) : -1;
+					if (byte == -1) {
+						*(unescapedTextPos++) = '\\';
+						*(unescapedTextPos++) = 'x';
+					} else {
+						if (byte == 0) {
+							*(unescapedTextPos++) = '\\';
+							*(unescapedTextPos++) = '0';
+						} else {
+							*(unescapedTextPos++) = (char)byte;
+						}
+						escapedText += 2;
+					}
+					break; }
+				default:
+					*(unescapedTextPos++) = '\\';
+					*(unescapedTextPos++) = *(escapedText++);
+					break;
+			}
+		} else {
+			*(unescapedTextPos++) = *(escapedText++);
+		}
+	}
+	
+	return unescapedTextPos - unescapedText;
+}
 NSString* bytesToHexString(const uint8_t *bytes, NSUInteger length) {
 	char table[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
 	char hexString[length * 2 + 1];
@@ -0,0 +1,41 @@
+//
+//  GPGImageCache.h
+//  Libmacgpg
+//
+
+#import <Foundation/Foundation.h>
+
+@class GPGUserID, NSImage;
+
+/*
+ * Decodes the photos of user attributes (UATs) in the background and keeps the most recently used ones.
+ *
+ * The key loader only stores the JPEG data of a photo in its GPGUserID. The image is created when
+ * -[GPGUserID image] is first called: the cache returns nil, decodes the data on a background queue
+ * and notifies observers of the user ID's image on the main queue, when the image is ready.
+ *
+ * Images are cached by the hashID of their user ID, so a reloaded key finds the image of the
+ * previous instance. The least recently used images are removed, when the decoded images would
+ * use more than the cost limit.
+ */
+@interface GPGImageCache : NSObject {
+	NSMutableDictionary *_images; // hashID -> NSImage, or NSNull for data which isn't an image.
+	NSMutableOrderedSet *_usage; // hashIDs, least recently used first.
+	NSMutableDictionary *_costs; // hashID -> NSNumber.
+	NSMutableSet *_pendingKeys; // hashIDs being decoded.
+	NSUInteger _totalCost;
+	NSUInteger _costLimit;
+	dispatch_queue_t _decodingQueue;
+}
+
++ (instancetype)sharedCache;
+
+/* The image of userID, if it's cached. Otherwise starts decoding userID.imageData and returns nil. */
+- (NSImage *)imageForUserID:(GPGUserID *)userID;
+
+- (void)removeAllImages;
+
+/* The approximate size in bytes of all decoded images. Default is 32 MB. */
+@property (nonatomic) NSUInteger costLimit;
+
+@end
@@ -0,0 +1,159 @@
+//
+//  GPGImageCache.m
+//  Libmacgpg
+//
+
+#import "GPGImageCache.h"
+#import "GPGTypesRW.h"
+
+#define DEFAULT_COST_LIMIT (32 * 1024 * 1024)
+
+
+@implementation GPGImageCache
+
++ (instancetype)sharedCache {
+	static dispatch_once_t onceToken;
+	static GPGImageCache *sharedCache;
+	dispatch_once(&onceToken, ^{
+		sharedCache = [[self alloc] init];
+	});
+	return sharedCache;
+}
+
+- (instancetype)init {
+	self = [super init];
+	if (!self) {
+		return nil;
+	}
+
+	_images = [[NSMutableDictionary alloc] init];
+	_usage = [[NSMutableOrderedSet alloc] init];
+	_costs = [[NSMutableDictionary alloc] init];
+	_pendingKeys = [[NSMutableSet alloc] init];
+	_costLimit = DEFAULT_COST_LIMIT;
+	_decodingQueue = dispatch_queue_create("org.gpgtools.libmacgpg.GPGImageCache.decoder", NULL);
+	dispatch_set_target_queue(_decodingQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0));
+
+	return self;
+}
+
+- (void)dealloc {
+	[_images release];
+	[_usage release];
+	[_costs release];
+	[_pendingKeys release];
+	dispatch_release(_decodingQueue);
+	[super dealloc];
+}
+
+
+#pragma mark Decoding
+
++ (NSImage *)decodeImageData:(NSData *)data cost:(NSUInteger *)cost {
+	NSImage *image = [[[NSImage alloc] initWithData:data] autorelease];
+	NSImageRep *imageRep = image.representations.firstObject;
+	if (!imageRep) {
+		*cost = 0;
+		return nil;
+	}
+
+	NSSize size = imageRep.size;
+	if (size.width != imageRep.pixelsWide || size.height != imageRep.pixelsHigh) { // Fix image size if needed.
+		size.width = imageRep.pixelsWide;
+		size.height = imageRep.pixelsHigh;
+		imageRep.size = size;
+		[image setSize:size];
+	}
+	*cost = imageRep.pixelsWide * imageRep.pixelsHigh * 4;
+
+	return image;
+}
+
+- (NSImage *)imageForUserID:(GPGUserID *)userID {
+	NSString *key = userID.hashID;
+	NSData *data = userID.imageData;
+	if (!key || !data) {
+		return nil;
+	}
+
+	@synchronized (self) {
+		id image = [_images objectForKey:key];
+		if (image) {
+			[_usage removeObject:key];
+			[_usage addObject:key];
+			return image == [NSNull null] ? nil : [[image retain] autorelease];
+		}
+		if ([_pendingKeys containsObject:key]) {
+			return nil;
+		}
+		[_pendingKeys addObject:key];
+	}
+
+	dispatch_async(_decodingQueue, ^{
+		@autoreleasepool {
+			NSUInteger cost = 0;
+			NSImage *image = [GPGImageCache decodeImageData:data cost:&cost];
+			[self setImage:image cost:cost forKey:key];
+
+			if (image) {
+				dispatch_async(dispatch_get_main_queue(), ^{
+					// Observers get the image from the cache now.
+					[userID willChangeValueForKey:@"image"];
+					[userID didChangeValueForKey:@"image"];
+				});
+			}
+		}
+	});
+
+	return nil;
+}
+
+- (void)setImage:(NSImage *)image cost:(NSUInteger)cost forKey:(NSString *)key {
+	@synchronized (self) {
+		[_pendingKeys removeObject:key];
+		[_images setObject:image ? (id)image : [NSNull null] forKey:key];
+		[_costs setObject:@(cost) forKey:key];
+		[_usage addObject:key];
+		_totalCost += cost;
+		[self evictImages];
+	}
+}
+
+// Must be called in @synchronized (self).
+- (void)evictImages {
+	// The newest image always stays, even if it's larger than the limit.
+	while (_totalCost > _costLimit && _usage.count > 1) {
+		NSString *key = [[_usage.firstObject retain] autorelease];
+		_totalCost -= [[_costs objectForKey:key] unsignedIntegerValue];
+		[_usage removeObjectAtIndex:0];
+		[_images removeObjectForKey:key];
+		[_costs removeObjectForKey:key];
+	}
+}
+
+
+#pragma mark Properties
+
+- (NSUInteger)costLimit {
+	@synchronized (self) {
+		return _costLimit;
+	}
+}
+
+- (void)setCostLimit:(NSUInteger)costLimit {
+	@synchronized (self) {
+		_costLimit = costLimit;
+		[self evictImages];
+	}
+}
+
+- (void)removeAllImages {
+	@synchronized (self) {
+		[_images removeAllObjects];
+		[_usage removeAllObjects];
+		[_costs removeAllObjects];
+		_totalCost = 0;
+	}
+}
+
+@end
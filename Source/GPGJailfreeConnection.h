@@ -0,0 +1,51 @@
+#if defined(__MAC_OS_X_VERSION_MAX_ALLOWED) && __MAC_OS_X_VERSION_MAX_ALLOWED >= 1080
+
+//
+//  GPGJailfreeConnection.h
+//  Libmacgpg
+//
+
+#import <Foundation/Foundation.h>
+#import "JailfreeProtocol.h"
+
+/*
+ * A long-lived connection to the org.gpgtools.Libmacgpg.xpc service, shared by all GPGTaskHelperXPC instances.
+ *
+ * Requests are multiplexed over the one NSXPCConnection. Every request uses its own remote object proxy,
+ * so errors are reported to the request they belong to. Callbacks from the service (status, progress)
+ * are sent to a per-request object, which is passed as argument, instead of the connection's exported object.
+ *
+ * Before the first request, and after the service was interrupted, the connection is checked with
+ * -testConnection:. Only one check runs at a time, all requests arriving meanwhile wait for its result.
+ * An invalidated connection is replaced by a new one on the next request.
+ */
+@interface GPGJailfreeConnection : NSObject {
+	NSXPCConnection *_connection;
+	NSXPCListenerEndpoint *_endpoint;
+	BOOL _verified;
+	dispatch_group_t _healthCheck; // The running -testConnection: check, the requests wait on it. NULL if none is running.
+	NSUInteger _healthCheckNumber; // Identifies the running check, so a late answer to an earlier one is ignored.
+}
+
+/* The shared connection to org.gpgtools.Libmacgpg.xpc. */
++ (GPGJailfreeConnection *)sharedConnection;
+
+/* The interface of the Jailfree protocol. Used by the client and the service. */
++ (NSXPCInterface *)jailfreeInterface;
+
+/* A connection to the service behind endpoint, e.g. an in-process service for testing. */
+- (id)initWithListenerEndpoint:(NSXPCListenerEndpoint *)endpoint;
+
+/*
+ * Returns a proxy for one request, after making sure the service is reachable.
+ * Returns nil if the service doesn't answer.
+ * errorHandler is called if the connection is interrupted or invalidated while a reply is outstanding.
+ */
+- (id <Jailfree>)remoteObjectProxyWithErrorHandler:(void (^)(NSError *error))errorHandler;
+
+/* Drops the current NSXPCConnection. The next request creates a new one. */
+- (void)invalidate;
+
+@end
+
+#endif
@@ -0,0 +1,191 @@
+#if defined(__MAC_OS_X_VERSION_MAX_ALLOWED) && __MAC_OS_X_VERSION_MAX_ALLOWED >= 1080
+
+//
+//  GPGJailfreeConnection.m
+//  Libmacgpg
+//
+
+#import "GPGJailfreeConnection.h"
+#import "GPGGlobals.h"
+
+// How long to wait for the answer to -testConnection:.
+static const int64_t kHealthCheckTimeout = 10 * NSEC_PER_SEC;
+
+
+@interface GPGJailfreeConnection ()
+- (void)finishHealthCheck:(NSUInteger)number ofConnection:(NSXPCConnection *)connection healthy:(BOOL)healthy;
+- (void)invalidateConnection:(NSXPCConnection *)expectedConnection;
+@end
+
+
+@implementation GPGJailfreeConnection
+
++ (GPGJailfreeConnection *)sharedConnection {
+	static GPGJailfreeConnection *sharedConnection = nil;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		sharedConnection = [[GPGJailfreeConnection alloc] init];
+	});
+	return sharedConnection;
+}
+
++ (NSXPCInterface *)jailfreeInterface {
+	NSXPCInterface *interface = [NSXPCInterface interfaceWithProtocol:@protocol(Jailfree)];
+	// The callbacks argument is sent as proxy, so the service can call back the object of the request.
+	[interface setInterface:[NSXPCInterface interfaceWithProtocol:@protocol(Jail)]
+				forSelector:@selector(launchGPGWithArguments:input:inputLength:output:readAttributes:closeInput:callbacks:reply:)
+			  argumentIndex:6
+					ofReply:NO];
+	return interface;
+}
+
+- (id)initWithListenerEndpoint:(NSXPCListenerEndpoint *)endpoint {
+	self = [super init];
+	if (self) {
+		_endpoint = [endpoint retain];
+	}
+	return self;
+}
+
+/* Must be called while synchronized on self. */
+- (NSXPCConnection *)connection {
+	if (_connection) {
+		return _connection;
+	}
+
+	if (_endpoint) {
+		_connection = [[NSXPCConnection alloc] initWithListenerEndpoint:_endpoint];
+	} else {
+		_connection = [[NSXPCConnection alloc] initWithMachServiceName:JAILFREE_XPC_NAME options:0];
+	}
+	_connection.remoteObjectInterface = [[self class] jailfreeInterface];
+	_verified = NO;
+
+	__block GPGJailfreeConnection *weakSelf = self;
+	__block NSXPCConnection *weakConnection = _connection;
+
+	// The service crashed or exited. The next message relaunches it, but check it first.
+	_connection.interruptionHandler = ^{
+		@synchronized (weakSelf) {
+			if (weakSelf->_connection == weakConnection) {
+				weakSelf->_verified = NO;
+			}
+		}
+	};
+	// The service couldn't be found or the connection was invalidated. Use a new connection for the next request.
+	_connection.invalidationHandler = ^{
+		GPGDebugLog(@"Connection to the xpc service was invalidated.");
+		@synchronized (weakSelf) {
+			if (weakSelf->_connection == weakConnection) {
+				[weakSelf->_connection release];
+				weakSelf->_connection = nil;
+				weakSelf->_verified = NO;
+			}
+		}
+	};
+
+	[_connection resume];
+
+	return _connection;
+}
+
+- (id <Jailfree>)remoteObjectProxyWithErrorHandler:(void (^)(NSError *error))errorHandler {
+	NSXPCConnection *connection = nil;
+	dispatch_group_t healthCheck = NULL;
+	NSUInteger number = 0;
+	BOOL startCheck = NO;
+
+	@synchronized (self) {
+		connection = [self connection];
+		if (_verified) {
+			return [connection remoteObjectProxyWithErrorHandler:errorHandler];
+		}
+
+		// Only one request checks the connection, the others wait for the result.
+		if (!_healthCheck) {
+			_healthCheck = dispatch_group_create();
+			dispatch_group_enter(_healthCheck);
+			_healthCheckNumber++;
+			startCheck = YES;
+		}
+		healthCheck = _healthCheck;
+		dispatch_retain(healthCheck);
+		number = _healthCheckNumber;
+		[connection retain];
+	}
+
+	// The lock isn't held while waiting, so the handlers of the connection aren't blocked.
+	if (startCheck) {
+		id <Jailfree> proxy = [connection remoteObjectProxyWithErrorHandler:^(NSError *error) {
+			[self finishHealthCheck:number ofConnection:connection healthy:NO];
+		}];
+		[proxy testConnection:^(BOOL result) {
+			[self finishHealthCheck:number ofConnection:connection healthy:result];
+		}];
+	}
+
+	if (dispatch_group_wait(healthCheck, dispatch_time(DISPATCH_TIME_NOW, kHealthCheckTimeout)) != 0) {
+		[self finishHealthCheck:number ofConnection:connection healthy:NO];
+	}
+	dispatch_release(healthCheck);
+
+	id <Jailfree> proxy = nil;
+	@synchronized (self) {
+		if (_verified && _connection == connection) {
+			proxy = [connection remoteObjectProxyWithErrorHandler:errorHandler];
+		}
+	}
+	[connection release];
+	return proxy;
+}
+
+/* Ends the check with the given number. Called by the handlers of -testConnection: and on timeout, only the first call counts. */
+- (void)finishHealthCheck:(NSUInteger)number ofConnection:(NSXPCConnection *)connection healthy:(BOOL)healthy {
+	BOOL invalidate = NO;
+	@synchronized (self) {
+		if (!_healthCheck || number != _healthCheckNumber) {
+			return;
+		}
+		if (_connection == connection) {
+			_verified = healthy;
+			invalidate = !healthy;
+		}
+		dispatch_group_leave(_healthCheck);
+		dispatch_release(_healthCheck);
+		_healthCheck = NULL;
+	}
+	if (invalidate) {
+		[self invalidateConnection:connection];
+	}
+}
+
+- (void)invalidate {
+	[self invalidateConnection:nil];
+}
+
+/* Drops expectedConnection, if it's still the current connection. Drops any connection if expectedConnection is nil. */
+- (void)invalidateConnection:(NSXPCConnection *)expectedConnection {
+	NSXPCConnection *connection = nil;
+	@synchronized (self) {
+		if (expectedConnection && _connection != expectedConnection) {
+			return;
+		}
+		connection = _connection;
+		_connection = nil;
+		_verified = NO;
+	}
+	connection.interruptionHandler = nil;
+	connection.invalidationHandler = nil;
+	[connection invalidate];
+	[connection release];
+}
+
+- (void)dealloc {
+	[self invalidate];
+	[_endpoint release];
+	[super dealloc];
+}
+
+@end
+
+#endif
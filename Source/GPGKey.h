@@ -19,12 +19,13 @@
 
 #import <Libmacgpg/GPGGlobals.h>
 #import <Libmacgpg/GPGUserID.h>
-@class GPGUserIDSignature;
+@class GPGUserIDSignature, GPGKeyManager;
 
 @interface GPGKey : NSObject <KeyFingerprint, GPGUserIDProtocol> {
 	NSString *_keyID;
 	NSString *_fingerprint;
 	NSString *_cardID; // The id of the smartcard, the key is located on. Only on secret keys.
+	NSString *_keygrip; // The hash of the public key material, used by gpg-agent to name the secret key.
 	NSDate *_creationDate;
 	NSDate *_expirationDate;
 	unsigned int _length;
@@ -62,6 +63,7 @@
 	// to self.
 	GPGKey *_primaryKey;
 	GPGUserID *_primaryUserID;
+	GPGKeyManager *_keyManager;
 }
 
 - (instancetype)initWithFingerprint:(NSString *)fingerprint;
@@ -72,6 +74,7 @@
 @property (copy, nonatomic, readonly) NSString *shortKeyID;
 @property (copy, nonatomic, readonly) NSString *fingerprint;
 @property (copy, nonatomic, readonly) NSString *cardID;
+@property (copy, nonatomic, readonly) NSString *keygrip;
 @property (copy, nonatomic, readonly) NSDate *creationDate;
 @property (copy, nonatomic, readonly) NSDate *expirationDate;
 @property (nonatomic, readonly) unsigned int length;
@@ -82,11 +85,15 @@
 
 @property (nonatomic, readonly) NSArray *subkeys;
 @property (nonatomic, readonly) NSArray *userIDs;
+// nil, if the key was loaded without signatures. Then they're loaded in the background and a new instance of the key
+// gets them, see -[GPGKeyManager loadSignaturesOfKeyIfNeeded:].
 @property (nonatomic, readonly) NSArray *signatures;
 @property (nonatomic, readonly) GPGUserIDSignature *revocationSignature;
 
 @property (nonatomic, readonly) GPGKey *primaryKey;
 @property (nonatomic, readonly) GPGUserID *primaryUserID;
+// The key manager which loaded this primary key. nil once the key manager has replaced the key.
+@property (nonatomic, readonly) GPGKeyManager *keyManager;
 
 @property (nonatomic, readonly) BOOL secret;
 @property (nonatomic, readonly) BOOL disabled;
@@ -116,6 +123,7 @@
 @property (nonatomic, readonly) NSString *name;
 @property (nonatomic, readonly) NSString *email;
 @property (nonatomic, readonly) NSString *comment;
+// Like -[GPGUserID image], nil until the photo is decoded. Observers of image are notified then.
 @property (nonatomic, readonly) NSImage *image;
 
 @end
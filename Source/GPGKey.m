@@ -19,10 +19,12 @@
 
 #import <Libmacgpg/GPGKey.h>
 #import <Libmacgpg/GPGTypesRW.h>
+#import "GPGSignatureList.h"
+#import <Libmacgpg/GPGKeyManager.h>
 
 
 @implementation GPGKey
-@synthesize subkeys=_subkeys, userIDs=_userIDs, signatures=_signatures, fingerprint=_fingerprint, cardID=_cardID, ownerTrust=_ownerTrust, secret=_secret, canSign=_canSign, canEncrypt=_canEncrypt, canCertify=_canCertify, canAuthenticate=_canAuthenticate, canAnySign=_canAnySign, canAnyEncrypt=_canAnyEncrypt, canAnyCertify=_canAnyCertify, canAnyAuthenticate=_canAnyAuthenticate, textForFilter=_textForFilter, primaryKey=_primaryKey, primaryUserID=_primaryUserID, keyID=_keyID, allFingerprints=_fingerprints, expirationDate=_expirationDate, creationDate=_creationDate, length=_length, algorithm=_algorithm, validity=_validity;
+@synthesize subkeys=_subkeys, userIDs=_userIDs, signatures=_signatures, fingerprint=_fingerprint, cardID=_cardID, keygrip=_keygrip, ownerTrust=_ownerTrust, secret=_secret, canSign=_canSign, canEncrypt=_canEncrypt, canCertify=_canCertify, canAuthenticate=_canAuthenticate, canAnySign=_canAnySign, canAnyEncrypt=_canAnyEncrypt, canAnyCertify=_canAnyCertify, canAnyAuthenticate=_canAnyAuthenticate, textForFilter=_textForFilter, primaryKey=_primaryKey, primaryUserID=_primaryUserID, keyManager=_keyManager, keyID=_keyID, allFingerprints=_fingerprints, expirationDate=_expirationDate, creationDate=_creationDate, length=_length, algorithm=_algorithm, validity=_validity;
 
 - (instancetype)init {
 	return [self initWithFingerprint:nil];
@@ -64,10 +66,14 @@
 		[oldValue release];
 		
 		GPGUserIDSignature *revSig = nil;
-		for (GPGUserIDSignature *sig in signatures) {
-			if (sig.revocation) {
-				revSig = sig;
-				break;
+		if ([signatures isKindOfClass:[GPGSignatureList class]]) {
+			revSig = [(GPGSignatureList *)signatures firstRevocationSignatureOnlyValid:NO];
+		} else {
+			for (GPGUserIDSignature *sig in signatures) {
+				if (sig.revocation) {
+					revSig = sig;
+					break;
+				}
 			}
 		}
 		if (revSig != _revocationSignature) {
@@ -79,6 +85,10 @@
 	}
 }
 - (NSArray *)signatures {
+	if (!_signatures) {
+		// Signatures are only loaded when they're used.
+		[_primaryKey.keyManager loadSignaturesOfKeyIfNeeded:self];
+	}
 	return [[_signatures retain] autorelease];
 }
 - (GPGUserIDSignature *)revocationSignature {
@@ -117,6 +127,10 @@
 - (NSImage *)image {
 	return self.primaryUserID.image;
 }
++ (NSSet *)keyPathsForValuesAffectingImage {
+	// The image of the primary user ID is decoded in the background.
+	return [NSSet setWithObject:@"primaryUserID.image"];
+}
 
 - (NSSet *)allFingerprints {
 	dispatch_semaphore_wait(_fingerprintsOnce, DISPATCH_TIME_FOREVER);
@@ -203,6 +217,9 @@
 	[_cardID release];
 	_cardID = nil;
 	
+	[_keygrip release];
+	_keygrip = nil;
+	
 	[_revocationSignature release];
 	_revocationSignature = nil;
 	
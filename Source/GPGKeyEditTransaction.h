@@ -0,0 +1,99 @@
+//
+//  GPGKeyEditTransaction.h
+//  Libmacgpg
+//
+
+#import <Foundation/Foundation.h>
+#import <Libmacgpg/GPGGlobals.h>
+
+@class GPGKey, GPGUserID, GPGUserIDSignature;
+
+
+typedef NS_ENUM(NSInteger, GPGKeyEditKind) {
+	GPGKeyEditSignUserIDs = 1,
+	GPGKeyEditRemoveSignature,
+	GPGKeyEditRevokeSignature,
+	GPGKeyEditAddUserID,
+	GPGKeyEditRemoveUserID,
+	GPGKeyEditRevokeUserID,
+	GPGKeyEditSetPrimaryUserID,
+	GPGKeyEditRemoveSubkey,
+	GPGKeyEditRevokeSubkey,
+	GPGKeyEditSetExpirationDate
+};
+
+
+/* A single edit of a GPGKeyEditTransaction. Only the properties used by its kind are set. */
+@interface GPGKeyEdit : NSObject {
+	GPGKeyEditKind _kind;
+	GPGKey *_key;
+	NSArray *_userIDs;
+	NSArray *_subkeys;
+	GPGUserIDSignature *_signature;
+	NSObject <KeyFingerprint> *_signerKey;
+	BOOL _local;
+	NSDate *_expirationDate;
+	int _reason;
+	NSString *_reasonDescription;
+	NSString *_name;
+	NSString *_email;
+	NSString *_comment;
+}
+
+@property (nonatomic, readonly) GPGKeyEditKind kind;
+@property (nonatomic, readonly) GPGKey *key; // The primary key.
+@property (nonatomic, readonly) NSArray *userIDs; // GPGUserIDs of key.
+@property (nonatomic, readonly) NSArray *subkeys; // GPGKeys of key. Empty to change the primary key.
+@property (nonatomic, readonly) GPGUserIDSignature *signature;
+@property (nonatomic, readonly) NSObject <KeyFingerprint> *signerKey;
+@property (nonatomic, readonly) BOOL local;
+@property (nonatomic, readonly) NSDate *expirationDate;
+@property (nonatomic, readonly) int reason;
+@property (nonatomic, readonly) NSString *reasonDescription;
+@property (nonatomic, readonly) NSString *name;
+@property (nonatomic, readonly) NSString *email;
+@property (nonatomic, readonly) NSString *comment;
+
+/* YES if the edit changes the indexes of the user IDs or subkeys following the edited one. */
+@property (nonatomic, readonly) BOOL removesItem;
+
+@end
+
+
+/*
+ * Collects edits of one or more keys, which -[GPGController performKeyEditTransaction:] runs together.
+ *
+ * Instead of one gpg --edit-key per edit, the controller runs one session per key. Only signatures of
+ * a further signer key, removals and revocations of signatures need sessions of their own.
+ *
+ * User IDs and subkeys are passed as the objects loaded by GPGKeyManager. The controller selects them
+ * in gpg by their position in the loaded key and only lists the key with gpg, if the keyring changed since.
+ * The edits of a key are run in the order they were added, except that user IDs and subkeys are removed
+ * at the end of the session, so the indexes used by the other edits stay valid.
+ */
+@interface GPGKeyEditTransaction : NSObject {
+	NSMutableArray *_edits;
+}
+
++ (instancetype)transaction;
+
+- (void)signUserIDs:(NSArray <GPGUserID *> *)userIDs signerKey:(NSObject <KeyFingerprint> *)signerKey local:(BOOL)local expirationDate:(NSDate *)expirationDate;
+- (void)removeSignature:(GPGUserIDSignature *)signature fromUserID:(GPGUserID *)userID;
+- (void)revokeSignature:(GPGUserIDSignature *)signature fromUserID:(GPGUserID *)userID reason:(int)reason description:(NSString *)description;
+
+- (void)addUserIDToKey:(GPGKey *)key name:(NSString *)name email:(NSString *)email comment:(NSString *)comment;
+- (void)removeUserID:(GPGUserID *)userID;
+- (void)revokeUserID:(GPGUserID *)userID reason:(int)reason description:(NSString *)description;
+- (void)setPrimaryUserID:(GPGUserID *)userID;
+
+- (void)removeSubkey:(GPGKey *)subkey;
+- (void)revokeSubkey:(GPGKey *)subkey reason:(int)reason description:(NSString *)description;
+/* subkeys may be nil or empty, to change the expiration date of the primary key. */
+- (void)setExpirationDate:(NSDate *)expirationDate forSubkeys:(NSArray <GPGKey *> *)subkeys ofKey:(GPGKey *)key;
+
+/* The GPGKeyEdits in the order they were added. */
+@property (nonatomic, readonly) NSArray <GPGKeyEdit *> *edits;
+/* The primary keys changed by the transaction. */
+@property (nonatomic, readonly) NSSet <GPGKey *> *keys;
+
+@end
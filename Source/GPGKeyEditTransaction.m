@@ -0,0 +1,192 @@
+//
+//  GPGKeyEditTransaction.m
+//  Libmacgpg
+//
+
+#import "GPGKeyEditTransaction.h"
+#import "GPGKey.h"
+#import "GPGUserID.h"
+#import "GPGUserIDSignature.h"
+
+
+@interface GPGKeyEdit ()
+@property (nonatomic, readwrite) GPGKeyEditKind kind;
+@property (nonatomic, readwrite, retain) GPGKey *key;
+@property (nonatomic, readwrite, copy) NSArray *userIDs;
+@property (nonatomic, readwrite, copy) NSArray *subkeys;
+@property (nonatomic, readwrite, retain) GPGUserIDSignature *signature;
+@property (nonatomic, readwrite, retain) NSObject <KeyFingerprint> *signerKey;
+@property (nonatomic, readwrite) BOOL local;
+@property (nonatomic, readwrite, copy) NSDate *expirationDate;
+@property (nonatomic, readwrite) int reason;
+@property (nonatomic, readwrite, copy) NSString *reasonDescription;
+@property (nonatomic, readwrite, copy) NSString *name;
+@property (nonatomic, readwrite, copy) NSString *email;
+@property (nonatomic, readwrite, copy) NSString *comment;
+@end
+
+
+@implementation GPGKeyEdit
+@synthesize kind=_kind, key=_key, userIDs=_userIDs, subkeys=_subkeys, signature=_signature,
+			signerKey=_signerKey, local=_local, expirationDate=_expirationDate, reason=_reason,
+			reasonDescription=_reasonDescription, name=_name, email=_email, comment=_comment;
+
+- (instancetype)initWithKind:(GPGKeyEditKind)kind key:(GPGKey *)key {
+	self = [super init];
+	if (!self) {
+		return nil;
+	}
+	if (!key) {
+		[self release];
+		@throw [NSException exceptionWithName:NSInvalidArgumentException reason:@"No key given" userInfo:nil];
+	}
+
+	_kind = kind;
+	_key = [key.primaryKey retain];
+
+	return self;
+}
+
+- (void)dealloc {
+	[_key release];
+	[_userIDs release];
+	[_subkeys release];
+	[_signature release];
+	[_signerKey release];
+	[_expirationDate release];
+	[_reasonDescription release];
+	[_name release];
+	[_email release];
+	[_comment release];
+	[super dealloc];
+}
+
+- (BOOL)removesItem {
+	return _kind == GPGKeyEditRemoveUserID || _kind == GPGKeyEditRemoveSubkey;
+}
+
+- (NSString *)description {
+	return [NSString stringWithFormat:@"<%@: %p> kind %li, key %@", [self class], self, (long)_kind, _key.fingerprint];
+}
+
+@end
+
+
+@implementation GPGKeyEditTransaction
+@synthesize edits=_edits;
+
++ (instancetype)transaction {
+	return [[[self alloc] init] autorelease];
+}
+
+- (instancetype)init {
+	self = [super init];
+	if (!self) {
+		return nil;
+	}
+
+	_edits = [[NSMutableArray alloc] init];
+
+	return self;
+}
+
+- (void)dealloc {
+	[_edits release];
+	[super dealloc];
+}
+
+- (GPGKeyEdit *)addEditWithKind:(GPGKeyEditKind)kind key:(GPGKey *)key {
+	GPGKeyEdit *edit = [[GPGKeyEdit alloc] initWithKind:kind key:key];
+	[_edits addObject:edit];
+	[edit release];
+	return edit;
+}
+
+- (NSSet *)keys {
+	return [NSSet setWithArray:[_edits valueForKey:@"key"]];
+}
+
+
+#pragma mark Signatures
+
+- (void)signUserIDs:(NSArray <GPGUserID *> *)userIDs signerKey:(NSObject <KeyFingerprint> *)signerKey local:(BOOL)local expirationDate:(NSDate *)expirationDate {
+	if (userIDs.count == 0) {
+		@throw [NSException exceptionWithName:NSInvalidArgumentException reason:@"No userIDs given" userInfo:nil];
+	}
+	GPGKey *key = [(GPGUserID *)userIDs[0] primaryKey];
+	for (GPGUserID *userID in userIDs) {
+		if (userID.primaryKey != key) {
+			@throw [NSException exceptionWithName:NSInvalidArgumentException reason:@"userIDs from more than one key" userInfo:nil];
+		}
+	}
+
+	GPGKeyEdit *edit = [self addEditWithKind:GPGKeyEditSignUserIDs key:key];
+	edit.userIDs = userIDs;
+	edit.signerKey = signerKey;
+	edit.local = local;
+	edit.expirationDate = expirationDate;
+}
+
+- (void)removeSignature:(GPGUserIDSignature *)signature fromUserID:(GPGUserID *)userID {
+	GPGKeyEdit *edit = [self addEditWithKind:GPGKeyEditRemoveSignature key:userID.primaryKey];
+	edit.userIDs = @[userID];
+	edit.signature = signature;
+}
+
+- (void)revokeSignature:(GPGUserIDSignature *)signature fromUserID:(GPGUserID *)userID reason:(int)reason description:(NSString *)description {
+	GPGKeyEdit *edit = [self addEditWithKind:GPGKeyEditRevokeSignature key:userID.primaryKey];
+	edit.userIDs = @[userID];
+	edit.signature = signature;
+	edit.reason = reason;
+	edit.reasonDescription = description;
+}
+
+
+#pragma mark User IDs
+
+- (void)addUserIDToKey:(GPGKey *)key name:(NSString *)name email:(NSString *)email comment:(NSString *)comment {
+	GPGKeyEdit *edit = [self addEditWithKind:GPGKeyEditAddUserID key:key];
+	edit.name = name;
+	edit.email = email;
+	edit.comment = comment;
+}
+
+- (void)removeUserID:(GPGUserID *)userID {
+	GPGKeyEdit *edit = [self addEditWithKind:GPGKeyEditRemoveUserID key:userID.primaryKey];
+	edit.userIDs = @[userID];
+}
+
+- (void)revokeUserID:(GPGUserID *)userID reason:(int)reason description:(NSString *)description {
+	GPGKeyEdit *edit = [self addEditWithKind:GPGKeyEditRevokeUserID key:userID.primaryKey];
+	edit.userIDs = @[userID];
+	edit.reason = reason;
+	edit.reasonDescription = description;
+}
+
+- (void)setPrimaryUserID:(GPGUserID *)userID {
+	GPGKeyEdit *edit = [self addEditWithKind:GPGKeyEditSetPrimaryUserID key:userID.primaryKey];
+	edit.userIDs = @[userID];
+}
+
+
+#pragma mark Subkeys
+
+- (void)removeSubkey:(GPGKey *)subkey {
+	GPGKeyEdit *edit = [self addEditWithKind:GPGKeyEditRemoveSubkey key:subkey.primaryKey];
+	edit.subkeys = @[subkey];
+}
+
+- (void)revokeSubkey:(GPGKey *)subkey reason:(int)reason description:(NSString *)description {
+	GPGKeyEdit *edit = [self addEditWithKind:GPGKeyEditRevokeSubkey key:subkey.primaryKey];
+	edit.subkeys = @[subkey];
+	edit.reason = reason;
+	edit.reasonDescription = description;
+}
+
+- (void)setExpirationDate:(NSDate *)expirationDate forSubkeys:(NSArray <GPGKey *> *)subkeys ofKey:(GPGKey *)key {
+	GPGKeyEdit *edit = [self addEditWithKind:GPGKeyEditSetExpirationDate key:key];
+	edit.subkeys = subkeys ? subkeys : @[];
+	edit.expirationDate = expirationDate;
+}
+
+@end
@@ -1,33 +1,38 @@
+@class GPGKeyring, GPGKeySearchIndex, GPGWatcher;
 
 
 @interface GPGKeyManager : NSObject {
 	NSString *_homedir;
 	
-	NSSet *_allKeys;
-	NSSet *_allKeysAndSubkeys;
+	GPGKeyring *_keyring; // Never modified, only replaced.
 	
 	NSMutableSet *_mutableAllKeys;
-	NSDictionary *_keysByKeyID;
-	
-	dispatch_once_t _once_keysByKeyID;
+	GPGKeySearchIndex *_searchIndex; // Changed together with _keyring, in @synchronized (_searchIndex).
+	dispatch_once_t _keyringOnce;
 	
 	
 	dispatch_queue_t _keyLoadingQueue;
 	dispatch_queue_t _keyChangeNotificationQueue;
-	
-	NSSet *_secretKeys;
+	NSUInteger _keysChangedGeneration; // Only used on _keyChangeNotificationQueue, to debounce notifications.
+	CFAbsoluteTime _firstKeysChangedTime;
+	GPGWatcher *_watcher; // Only for instances created with initWithHomedir:.
+	dispatch_once_t _watcherOnce;
 	
 	dispatch_queue_t _completionQueue;
 	
 	NSMutableArray *_keyLoadingOperations;
 	dispatch_queue_t _keyLoadingOperationsLock;
+	NSMutableSet *_signatureFaults; // Fingerprints of the keys whose signatures are being loaded. Locked by @synchronized.
 
 	
 	//For loadKeys
 	
 	NSSet *_secKeyFingerprints;
 	NSDictionary *_secKeyInfos;
-	NSArray *_keyLines;
+	NSDictionary *_keyBlockHashes; // Fingerprint -> hash of the key's block in the last listing. For incremental reloads.
+	NSData *_secretListing; // The listing of all secret keys of the last full load, reused by the following loads.
+	NSData *_secretListingStamp;
+	CFAbsoluteTime _secretListingTime;
 	NSData *_attributeData;
 	NSMutableDictionary *_attributeInfos; // A dict of arrays of dict with: location, length, type, index, count.
 	NSUInteger _attributeDataLocation;
@@ -35,17 +40,33 @@
 	BOOL _fetchSignatures;
 	BOOL _allowWeakDigestAlgos;
 
-	
-	dispatch_semaphore_t _allKeysAndSubkeysOnce;
 }
 @property (nonatomic, copy) NSString *homedir;
 
 @property (nonatomic) BOOL allowWeakDigestAlgos;
 
+/* The current state of the keyring, replaced as a whole whenever a load changed the keys.
+ * The properties below are shortcuts for the properties of the current keyring. When using more than
+ * one of them, get the keyring once and use its properties, so they all belong to the same state.
+ * keyringGeneration is the generation of keyring. Compare it with a remembered generation, to find out
+ * whether anything has changed.
+ */
+@property (nonatomic, readonly) GPGKeyring *keyring;
+@property (nonatomic, readonly) NSUInteger keyringGeneration;
+
 @property (nonatomic, readonly) NSSet *allKeys;
 @property (nonatomic, readonly) NSSet *allKeysAndSubkeys;
 @property (nonatomic, readonly) NSDictionary *keysByKeyID;
 
+/* Indexes over allKeys, rebuilt whenever the keys are loaded.
+ * keysByFingerprint and keysByKeygrip map to the key or subkey itself.
+ * keysByEmail (lowercase email) and keysByUserIDHash map to an NSArray of primary keys.
+ */
+@property (nonatomic, readonly) NSDictionary *keysByFingerprint;
+@property (nonatomic, readonly) NSDictionary *keysByKeygrip;
+@property (nonatomic, readonly) NSDictionary *keysByEmail;
+@property (nonatomic, readonly) NSDictionary *keysByUserIDHash;
+
 /* Subset of allKeys including only secret keys. */
 @property (nonatomic, readonly) NSSet *secretKeys;
 
@@ -56,10 +77,19 @@
 @property (nonatomic, assign) dispatch_queue_t completionQueue;
 
 /*
- GPGKeyManager is a singleton.
+ The key manager of the default keyring.
  */
 + (GPGKeyManager *)sharedInstance;
 
+/*
+ Creates an independent key manager for the keyring in homedir, with its own keys, loading queue,
+ caches, watcher and notifications. Its GPGKeyManagerKeysDidChangeNotification is posted with the
+ key manager as object, and only in the own process.
+ All key managers together run a limited number of gpg processes at a time.
+ Keys loaded by a key manager must not be used on other threads while it's released.
+ */
+- (instancetype)initWithHomedir:(NSString *)homedir;
+
 /*
  Load the specified keys from gpg, pass nil to load all.
  keys: A set of GPGKeys.
@@ -95,13 +125,44 @@
  */
 - (void)loadSignaturesAndAttributesForKeys:(NSSet *)keys completionHandler:(void(^)(NSSet *))completionHandler;
 
+/* Starts loading the signatures of key in the background, unless they're already being loaded. Returns immediately.
+ * key is replaced by a new instance with signatures, which GPGKeyManagerKeysDidChangeNotification lists as modified.
+ * Called by -[GPGKey signatures] and -[GPGUserID signatures], so signatures are only loaded when they're used.
+ * Simultaneous calls for different keys are combined into one gpg call.
+ */
+- (void)loadSignaturesOfKeyIfNeeded:(GPGKey *)key;
+
 /*
  * Returns a human readable descryption of the keys.
  * Used whenever keys are listed in a dialog.
  */
 - (NSString *)descriptionForKeys:(NSArray *)keys;
 
+/* All primary keys with a user ID for email. The case of email is ignored. */
+- (NSArray *)keysForEmail:(NSString *)email;
+
+/* All primary keys whose textForFilter contains searchString, ignoring case and diacritics.
+ * Uses an index, which is updated when keys are loaded, so it's fast enough for type-ahead search.
+ */
+- (NSSet *)keysMatchingSearchString:(NSString *)searchString;
+
+/* The loaded primary key for the fingerprint of the key or one of its subkeys, but only if the keyring
+ * files haven't changed since it was listed. Otherwise, or if no keys are loaded, returns nil and gpg
+ * has to be asked. Never starts a load.
+ */
+- (GPGKey *)upToDateKeyWithFingerprint:(NSString *)fingerprint;
+
 @end
 
-/* Register to this notification to received notifications when keys were modified. */
+/* Register to this notification to received notifications when keys were modified.
+ * The userInfo contains the changes since the last notification, as arrays of fingerprints:
+ * GPGKeyManagerAddedKeysKey, GPGKeyManagerRemovedKeysKey and GPGKeyManagerModifiedKeysKey.
+ * GPGKeyManagerAffectedKeysKey contains all of them. If the arrays are missing, every key might have changed.
+ * GPGKeyManagerGenerationKey is the keyringGeneration after the change, as NSNumber.
+ */
 extern NSString * const GPGKeyManagerKeysDidChangeNotification;
+extern NSString * const GPGKeyManagerAddedKeysKey;
+extern NSString * const GPGKeyManagerRemovedKeysKey;
+extern NSString * const GPGKeyManagerModifiedKeysKey;
+extern NSString * const GPGKeyManagerAffectedKeysKey;
+extern NSString * const GPGKeyManagerGenerationKey;
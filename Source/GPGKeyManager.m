@@ -1,24 +1,66 @@
 
 #import "GPGKeyManager.h"
+#import "GPGKeyring.h"
 #import "GPGTypesRW.h"
 #import "GPGWatcher.h"
 #import "GPGTask.h"
 #import "GPGKeyMonitoring.h"
 #import "GPGTransformer.h"
+#import "GPGColonListing.h"
+#import "GPGColonListingStream.h"
+#import "GPGKeyringSnapshot.h"
+#import "GPGKeySearchIndex.h"
+#import "GPGSignatureList.h"
+#import "GPGStringTable.h"
 
 NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDidChangeNotification";
+NSString * const GPGKeyManagerAddedKeysKey = @"addedKeys";
+NSString * const GPGKeyManagerRemovedKeysKey = @"removedKeys";
+NSString * const GPGKeyManagerModifiedKeysKey = @"modifiedKeys";
+NSString * const GPGKeyManagerAffectedKeysKey = @"affectedKeys";
+NSString * const GPGKeyManagerGenerationKey = @"generation";
+
+static GPGKeyManager *sharedInstance = nil;
+
+// How long the listing of all secret keys is reused, if the keyring is unchanged.
+#define SECRET_LISTING_LIFETIME 5.0
+// Keys are loaded once there was no GPGKeysChangedNotification for KEYS_CHANGED_DELAY seconds,
+// but KEYS_CHANGED_MAX_DELAY seconds after the first notification at the latest.
+#define KEYS_CHANGED_DELAY 0.5
+#define KEYS_CHANGED_MAX_DELAY 3.0
+// Other processes only get the affected keys, if there are at most this many. Otherwise they reload all keys.
+#define DISTRIBUTED_AFFECTED_KEYS_LIMIT 100
+// The maximum number of gpg processes run by all key managers together.
+#define MAX_CONCURRENT_GPG_TASKS 4
 
 @interface GPGKeyManager () <GPGTaskDelegate>
 
-@property (nonatomic, copy, readwrite) NSDictionary *keysByKeyID;
-@property (nonatomic, copy, readwrite) NSSet *secretKeys;
+// Atomic, so readers on other threads always get a retained keyring, while the loader replaces it.
+@property (atomic, retain, readwrite) GPGKeyring *currentKeyring;
 
 @end
 
+// Starts task, but waits while there are MAX_CONCURRENT_GPG_TASKS tasks of key managers running.
+// Many key managers for different homedirs shouldn't start a gpg for each of them at once.
+static void startLimitedTask(GPGTask *task) {
+	static dispatch_semaphore_t semaphore;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		semaphore = dispatch_semaphore_create(MAX_CONCURRENT_GPG_TASKS);
+	});
+	
+	dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+	@try {
+		[task start];
+	}
+	@finally {
+		dispatch_semaphore_signal(semaphore);
+	}
+}
+
 @implementation GPGKeyManager
 
-@synthesize allKeys=_allKeys, keysByKeyID=_keysByKeyID,
-			secretKeys=_secretKeys, completionQueue=_completionQueue,
+@synthesize currentKeyring=_keyring, completionQueue=_completionQueue,
 			allowWeakDigestAlgos=_allowWeakDigestAlgos,
 			homedir=_homedir;
 
@@ -122,10 +164,11 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 		while (1) {
 			__block NSArray *operations = nil;
 			
-			// Locked access to _keyLoadingOperations.
+			// Take all waiting operations at once. Operations queued while loading are handled in the next round.
 			dispatch_sync(_keyLoadingOperationsLock, ^{
 				if (_keyLoadingOperations.count > 0) {
 					operations = [[_keyLoadingOperations copy] autorelease];
+					[_keyLoadingOperations removeAllObjects];
 				}
 			});
 			
@@ -134,75 +177,60 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 				break;
 			}
 			
-			// Get the next operation.
-			NSDictionary *operation = operations[0];
-			
-			// Which keys should be loaded?
-			NSSet *keys = operation[@"keys"];
-			NSMutableSet *keysToLoad = nil;
-			// If keys is nil or empty, all keys should be loaded.
-			if (keys.count > 0) {
-				// Only selected keys should be loaded, collect them in keysToLoad;
-				keysToLoad = [[keys mutableCopy] autorelease];
-			}
-			
-			
-			// Only loading operations with the same flags are combined.
+			// Combine the operations into one full load and one load of selected keys.
+			// Each of them fetches the extras requested by any of its operations.
 			// flags indicates whether signatures or attributes should be fetched.
-			NSUInteger flags = [operation[@"flags"] unsignedIntegerValue];
-			
-			
-			NSMutableArray *completionHandlers = [NSMutableArray array];
-			// If there is a completion handler, add it to the list.
-			if (operation[@"completionHandler"]) {
-				[completionHandlers addObject:operation[@"completionHandler"]];
-			}
+			BOOL fullLoad = NO;
+			NSUInteger fullLoadFlags = 0;
+			NSMutableArray *fullLoadHandlers = [NSMutableArray array];
+			NSMutableDictionary *selectedKeys = [NSMutableDictionary dictionary]; // Fingerprint -> GPGKey or fingerprint.
+			NSUInteger selectedKeysFlags = 0;
+			NSMutableArray *selectedKeysHandlers = [NSMutableArray array];
 			
-			// Indexes of operation in _keyLoadingOperations which are removed.
-			NSMutableIndexSet *indexesToRemove = [NSMutableIndexSet indexSetWithIndex:0];
-			
-			// Iterate through all remaining operations in operations.
-			NSUInteger count = operations.count;
-			for (NSUInteger i = 1; i < count; i++) {
-				operation = operations[i];
+			for (NSDictionary *operation in operations) {
+				NSSet *keys = operation[@"keys"];
+				NSUInteger flags = [operation[@"flags"] unsignedIntegerValue];
+				id completionHandler = operation[@"completionHandler"];
 				
-				// Only combine if the flags are equal.
-				if ([operation[@"flags"] unsignedIntegerValue] == flags) {
-					
-					// Add selected keys to loadAllKeys if appropriate.
-					if (keysToLoad) {
-						keys = operation[@"keys"];
-						if (keys.count == 0) {
-							// Load all keys.
-							keysToLoad = nil;
-						} else {
-							[keysToLoad unionSet:keys];
-						}
+				// If keys is empty, all keys should be loaded.
+				if (keys.count == 0) {
+					fullLoad = YES;
+					fullLoadFlags |= flags;
+					if (completionHandler) {
+						[fullLoadHandlers addObject:completionHandler];
 					}
-					
-					// If there is a completion handler, add it to the list.
-					if (operation[@"completionHandler"]) {
-						[completionHandlers addObject:operation[@"completionHandler"]];
+				} else {
+					// keys might contain GPGKeys and fingerprints. Every key is only loaded once.
+					for (id key in keys) {
+						[selectedKeys setObject:key forKey:[key description]];
+					}
+					selectedKeysFlags |= flags;
+					if (completionHandler) {
+						[selectedKeysHandlers addObject:completionHandler];
 					}
-					
-					// Remove this operation from _keyLoadingOperations.
-					[indexesToRemove addIndex:i];
 				}
 			}
 			
-			// Locked access to _keyLoadingOperations.
-			dispatch_sync(_keyLoadingOperationsLock, ^{
-				// Remove all combined operations.
-				[_keyLoadingOperations removeObjectsAtIndexes:indexesToRemove];
-			});
-			
+			// The full load includes the selected keys, if it fetches the same extras.
+			// Otherwise they're loaded separately. Signatures or attributes of all keys would take much longer.
+			if (fullLoad && (selectedKeysFlags & ~fullLoadFlags) == 0) {
+				[fullLoadHandlers addObjectsFromArray:selectedKeysHandlers];
+				[selectedKeysHandlers removeAllObjects];
+				[selectedKeys removeAllObjects];
+			}
 			
 			// Load the keys. This is a synchronous method.
-			[self _loadKeys:keysToLoad fetchSignatures:flags & 1 fetchUserAttributes:flags & 2];
-			
-			// Call all completion handlers.
-			for (void (^completionHandler)() in completionHandlers) {
-				completionHandler();
+			if (fullLoad) {
+				[self _loadKeys:nil fetchSignatures:fullLoadFlags & 1 fetchUserAttributes:fullLoadFlags & 2];
+				for (void (^completionHandler)() in fullLoadHandlers) {
+					completionHandler();
+				}
+			}
+			if (selectedKeys.count > 0) {
+				[self _loadKeys:[NSSet setWithArray:selectedKeys.allValues] fetchSignatures:selectedKeysFlags & 1 fetchUserAttributes:selectedKeysFlags & 2];
+				for (void (^completionHandler)() in selectedKeysHandlers) {
+					completionHandler();
+				}
 			}
 			
 		}
@@ -212,6 +240,17 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 
 - (void)_loadKeys:(NSSet *)keys fetchSignatures:(BOOL)fetchSignatures fetchUserAttributes:(BOOL)fetchUserAttributes {
 	NSSet *newKeysSet = nil;
+	// The fingerprints of the keys changed by this load. nil if the load failed.
+	NSMutableArray *addedFingerprints = nil;
+	NSMutableArray *modifiedFingerprints = nil;
+	NSArray *removedFingerprints = nil;
+	GPGKeyringSnapshot *snapshot = nil;
+	GPGKeyring *newKeyring = nil;
+	// The changes of the search index, applied when newKeyring is published.
+	NSSet *indexedKeys = nil;
+	NSSet *unindexedFingerprints = nil;
+	BOOL clearSearchIndex = NO;
+	BOOL keysChanged = YES;
 	
 	//NSLog(@"[%@]: Loading keys!", [NSThread currentThread]);
 	@try {
@@ -220,68 +259,71 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 		_fetchSignatures = fetchSignatures;
 		_fetchUserAttributes = fetchUserAttributes;
 		
-		// 1. Fetch all secret keys.
-		@try {
-			// Get all fingerprints of the secret keys.
-			GPGTask *gpgTask = [GPGTask gpgTask];
-			gpgTask.nonBlocking = YES;
-			if (_homedir) {
-				[gpgTask addArgument:@"--homedir"];
-				[gpgTask addArgument:_homedir];
-			}
-			gpgTask.batchMode = YES;
-			if (self.allowWeakDigestAlgos) {
-				[gpgTask addArgument:@"--allow-weak-digest-algos"];
-			}
-			[gpgTask addArgument:@"--list-secret-keys"];
-			[gpgTask addArgument:@"--with-fingerprint"];
-			[gpgTask addArgument:@"--with-fingerprint"];
-			[gpgTask addArguments:keyArguments];
-				
-			[gpgTask start];
-				
-			self->_secKeyInfos = [[self parseSecColonListing:gpgTask.outData.gpgLines] retain];
-        }
-		@catch (NSException *exception) {
-			//TODO: Set error code.
-			GPGDebugLog(@"Unable to load secret keys.")
+		// A full load at startup can use the snapshot of the last session, if the keyring is unchanged.
+		// The keys are refreshed from gpg in the background afterwards.
+		// Every other full load writes a new snapshot.
+		BOOL plainFullLoad = !keys && !fetchSignatures && !fetchUserAttributes;
+		NSString *homedir = _homedir ? _homedir : [GPGOptions sharedOptions].gpgHome;
+		NSData *keyringStamp = nil;
+		NSData *secretListing = nil;
+		NSData *publicListing = nil;
+		if (plainFullLoad && !_keyring) {
+			snapshot = [GPGKeyringSnapshot snapshotForHomedir:homedir];
 		}
-		
-		// Get the infos from gpg.
-		GPGTask *gpgTask = [GPGTask gpgTask];
-		gpgTask.nonBlocking = YES;
-		if (_homedir) {
-			[gpgTask addArgument:@"--homedir"];
-			[gpgTask addArgument:_homedir];
+		if (!snapshot) {
+			keyringStamp = [GPGKeyringSnapshot keyringStampForHomedir:homedir];
 		}
-		if (fetchSignatures) {
-			[gpgTask addArgument:@"--check-sigs"];
-			[gpgTask addArgument:@"--list-options"];
-			[gpgTask addArgument:@"show-sig-subpackets=29,show-sig-subpackets=30"];
+		
+		// 1. Fetch all secret keys.
+		if (snapshot) {
+			secretListing = snapshot.secretListing;
+		} else if (_secretListing && [_secretListingStamp isEqualToData:keyringStamp] &&
+				   CFAbsoluteTimeGetCurrent() - _secretListingTime < SECRET_LISTING_LIFETIME) {
+			// The keyring is unchanged since the last full load, which was only a moment ago.
+			// The listing isn't kept longer, because inserting a smartcard changes it too.
+			secretListing = _secretListing;
 		} else {
-			[gpgTask addArgument:@"--list-keys"];
-		}
-		if (fetchUserAttributes) {
-			_attributeInfos = [[NSMutableDictionary alloc] init];
-			_attributeDataLocation = 0;
-			gpgTask.getAttributeData = YES;
-			gpgTask.delegate = self;
+			@try {
+				// Get all fingerprints of the secret keys.
+				GPGTask *gpgTask = [GPGTask gpgTask];
+				gpgTask.nonBlocking = YES;
+				if (_homedir) {
+					[gpgTask addArgument:@"--homedir"];
+					[gpgTask addArgument:_homedir];
+				}
+				gpgTask.batchMode = YES;
+				if (self.allowWeakDigestAlgos) {
+					[gpgTask addArgument:@"--allow-weak-digest-algos"];
+				}
+				[gpgTask addArgument:@"--list-secret-keys"];
+				[gpgTask addArgument:@"--with-fingerprint"];
+				[gpgTask addArgument:@"--with-fingerprint"];
+				[gpgTask addArguments:keyArguments];
+				
+				startLimitedTask(gpgTask);
+				
+				secretListing = gpgTask.outData;
+				
+				if (!keys && secretListing) {
+					// Keep the listing of all secret keys for the next loads.
+					[_secretListing release];
+					_secretListing = [secretListing retain];
+					[_secretListingStamp release];
+					_secretListingStamp = [keyringStamp retain];
+					_secretListingTime = CFAbsoluteTimeGetCurrent();
+				}
+			}
+			@catch (NSException *exception) {
+				//TODO: Set error code.
+				GPGDebugLog(@"Unable to load secret keys.")
+			}
 		}
-		if (self.allowWeakDigestAlgos) {
-			[gpgTask addArgument:@"--allow-weak-digest-algos"];
+		if (secretListing) {
+			self->_secKeyInfos = [[self parseSecColonListing:[GPGColonListing listingWithData:secretListing]] retain];
 		}
-		[gpgTask addArgument:@"--with-fingerprint"];
-		[gpgTask addArgument:@"--with-fingerprint"];
-		[gpgTask addArguments:keyArguments];
-		
-		// TODO: We might have to retain this task, since it might be used in a delegate.
-		[gpgTask start];
 		
 		// ======= Parsing =======
-
-		_attributeData = [gpgTask.attributeData retain]; //attributeData is only needed for UATs (PhotoID).
-		_keyLines = gpgTask.outData.gpgLines;
-
+		
 		dispatch_queue_t dispatchQueue = NULL;
 		if(floor(NSAppKitVersionNumber) > NSAppKitVersionNumber10_6)
 			dispatchQueue = dispatch_queue_create("org.gpgtools.libmacgpg._loadKeys.gpgTask", DISPATCH_QUEUE_CONCURRENT);
@@ -291,77 +333,245 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 		}
 		dispatch_group_t dispatchGroup = dispatch_group_create();
 
-		NSMutableArray *newKeys = [[NSMutableArray alloc] init];
+		NSMutableArray *newKeys = [NSMutableArray array];
+		NSMutableSet *changedKeys = [NSMutableSet set];
+		__block NSException *fillException = nil;
+		
+		// Incremental reload: A key, whose block in the listing is unchanged since the last load,
+		// is reused instead of parsed again. Only possible for plain listings, because the blocks
+		// of --check-sigs or with attributes differ.
+		BOOL reuseUnchangedKeys = !fetchSignatures && !fetchUserAttributes;
+		NSMutableDictionary *blockHashes = nil;
+		NSMutableDictionary *existingKeys = nil;
+		if (reuseUnchangedKeys) {
+			blockHashes = [NSMutableDictionary dictionary];
+			existingKeys = [NSMutableDictionary dictionaryWithCapacity:_mutableAllKeys.count];
+			for (GPGKey *key in _mutableAllKeys) {
+				if (key.fingerprint) {
+					[existingKeys setObject:key forKey:key.fingerprint];
+				}
+			}
+		}
 		
-		// Loop thru all lines. Starting with the last line.
-		NSUInteger lastLine = _keyLines.count;
-		NSInteger index = lastLine - 1;
-		for (; index >= 0; index--) {
-			NSString *line = [_keyLines objectAtIndex:index];
-			if ([line hasPrefix:@"pub"]) {
+		// Parses the pub blocks of listing. Called with parts of gpg's output while gpg is still running.
+		// Every pub block is independent of the others and only reads its listing, _secKeyInfos,
+		// _attributeInfos and _attributeData, which aren't modified until all blocks are done.
+		// So the keys are filled concurrently. The order of newKeys is decided here, not by the workers.
+		void (^parseListing)(GPGColonListing *listing) = ^(GPGColonListing *listing) {
+			NSUInteger lineCount = listing.lineCount;
+			NSUInteger index = 0;
+			while (index < lineCount && ![listing line:index hasType:"pub"]) {
+				index++;
+			}
+			while (index < lineCount) {
+				NSUInteger nextKey = index + 1;
+				while (nextKey < lineCount && ![listing line:nextKey hasType:"pub"]) {
+					nextKey++;
+				}
+				NSRange range = NSMakeRange(index, nextKey - index);
+				index = nextKey;
+				
+				if (reuseUnchangedKeys) {
+					NSString *fingerprint = [self fingerprintOfKeyInListing:listing range:range];
+					NSNumber *hash = [self hashOfKeyInListing:listing range:range];
+					[blockHashes setObject:hash forKey:fingerprint];
+					
+					GPGKey *existingKey = [existingKeys objectForKey:fingerprint];
+					if (existingKey && [[_keyBlockHashes objectForKey:fingerprint] isEqualToNumber:hash]) {
+						[newKeys addObject:existingKey];
+						continue;
+					}
+				}
+				
 				GPGKey *key = [[GPGKey alloc] init];
+				key.keyManager = self;
 				[newKeys addObject:key];
+				[changedKeys addObject:key];
 				[key release];
 				
-				@autoreleasepool {
-					[self fillKey:key withRange:NSMakeRange(index, lastLine - index)];
+				dispatch_group_async(dispatchGroup, dispatchQueue, ^{
+					@autoreleasepool {
+						@try {
+							[self fillKey:key fromListing:listing range:range];
+						}
+						@catch (NSException *exception) {
+							// Exceptions can't leave a dispatch block. Rethrown below.
+							@synchronized (newKeys) {
+								if (!fillException) {
+									fillException = [exception retain];
+								}
+							}
+						}
+					}
+				});
+			}
+		};
+		
+		@try {
+			if (snapshot) {
+				publicListing = snapshot.publicListing;
+				parseListing([GPGColonListing listingWithData:publicListing]);
+			} else {
+				// Get the infos from gpg.
+				GPGTask *gpgTask = [GPGTask gpgTask];
+				gpgTask.nonBlocking = YES;
+				if (_homedir) {
+					[gpgTask addArgument:@"--homedir"];
+					[gpgTask addArgument:_homedir];
+				}
+				if (fetchSignatures) {
+					[gpgTask addArgument:@"--check-sigs"];
+					[gpgTask addArgument:@"--list-options"];
+					[gpgTask addArgument:@"show-sig-subpackets=29,show-sig-subpackets=30"];
+				} else {
+					[gpgTask addArgument:@"--list-keys"];
+				}
+				GPGColonListingStream *listingStream = nil;
+				if (fetchUserAttributes) {
+					_attributeInfos = [[NSMutableDictionary alloc] init];
+					_attributeDataLocation = 0;
+					gpgTask.getAttributeData = YES;
+					gpgTask.delegate = self;
+				} else {
+					// Parse the keys while gpg is still listing. Not possible with attributes,
+					// because they're only available when gpg is done.
+					listingStream = [[[GPGColonListingStream alloc] initWithHandler:parseListing] autorelease];
+					// The listing itself is only needed for the snapshot.
+					listingStream.keepsData = plainFullLoad;
+					gpgTask.outStream = listingStream;
+				}
+				if (self.allowWeakDigestAlgos) {
+					[gpgTask addArgument:@"--allow-weak-digest-algos"];
+				}
+				[gpgTask addArgument:@"--with-fingerprint"];
+				[gpgTask addArgument:@"--with-fingerprint"];
+				[gpgTask addArgument:@"--with-keygrip"];
+				[gpgTask addArguments:keyArguments];
+			
+				// TODO: We might have to retain this task, since it might be used in a delegate.
+				startLimitedTask(gpgTask);
+				
+				_attributeData = [gpgTask.attributeData retain]; //attributeData is only needed for UATs (PhotoID).
+				publicListing = gpgTask.outData;
+				
+				if (listingStream) {
+					[listingStream finish];
+				} else {
+					parseListing([GPGColonListing listingWithData:publicListing]);
 				}
-
-				lastLine = index;
 			}
 		}
-		
-		dispatch_group_wait(dispatchGroup, DISPATCH_TIME_FOREVER);
-        dispatch_release(dispatchGroup);
-        dispatch_release(dispatchQueue);
+		@finally {
+			// Keys already being filled use the state of the loader. Wait for them, even if gpg failed.
+			dispatch_group_wait(dispatchGroup, DISPATCH_TIME_FOREVER);
+			dispatch_release(dispatchGroup);
+			dispatch_release(dispatchQueue);
+		}
 		
 		[_attributeData release];
 		[_attributeInfos release];
 		_attributeInfos = nil;
 		
+		if (fillException) {
+			@throw [fillException autorelease];
+		}
+		
 		// TODO: Es kann vorkommen, dass ein Key doppelt von gpg2 gelistet wird. Einmal mit und einmal ohne Signaturen.
 		// Wenn das passiert, kann es sein, dass der Key mit mehr Signaturen nicht im newKeysSet landet.
 		newKeysSet = [NSSet setWithArray:newKeys];
-		[newKeys release];
 		
+		// Keys which are gone. keys might contain fingerprints, so compare the fingerprints.
+		NSMutableSet *goneFingerprints = [NSMutableSet setWithSet:[keys ? keys : _mutableAllKeys valueForKey:@"description"]];
+		[goneFingerprints minusSet:[newKeysSet valueForKey:@"description"]];
+		
+		// The delta for the notification. Reused keys are unchanged, all others are new or replace a key.
+		NSDictionary *oldKeysByFingerprint = _keyring.keysByFingerprint;
+		addedFingerprints = [NSMutableArray array];
+		modifiedFingerprints = [NSMutableArray array];
+		for (GPGKey *key in changedKeys) {
+			NSString *fingerprint = key.description;
+			if ([oldKeysByFingerprint objectForKey:fingerprint]) {
+				[modifiedFingerprints addObject:fingerprint];
+			} else {
+				[addedFingerprints addObject:fingerprint];
+			}
+		}
+		removedFingerprints = goneFingerprints.allObjects;
+		
+		NSMutableArray *oldKeys = [NSMutableArray array];
 		if (keys) {
+			for (id key in [keys setByAddingObjectsFromSet:newKeysSet]) {
+				GPGKey *oldKey = [_mutableAllKeys member:key];
+				if (oldKey) {
+					[oldKeys addObject:oldKey];
+				}
+			}
 			[_mutableAllKeys minusSet:keys];
 			[_mutableAllKeys minusSet:newKeysSet];
 		} else {
+			[oldKeys addObjectsFromArray:_mutableAllKeys.allObjects];
 			[_mutableAllKeys removeAllObjects];
 		}
 		[_mutableAllKeys unionSet:newKeysSet];
 		
+		// Replaced and removed keys no longer point to the key manager, so they don't outlive it with a dangling pointer.
+		for (GPGKey *oldKey in oldKeys) {
+			if ([_mutableAllKeys member:oldKey] != oldKey) {
+				oldKey.keyManager = nil;
+			}
+		}
 		
+		// Remember the hashes for the next load. Keys loaded with signatures or attributes have no hash,
+		// so they're parsed again on the next plain load.
+		NSMutableDictionary *keyBlockHashes = keys ? [NSMutableDictionary dictionaryWithDictionary:_keyBlockHashes] : [NSMutableDictionary dictionary];
+		if (keys) {
+			[keyBlockHashes removeObjectsForKeys:[[keys valueForKey:@"description"] allObjects]];
+			[keyBlockHashes removeObjectsForKeys:[[newKeysSet valueForKey:@"description"] allObjects]];
+		}
+		if (blockHashes) {
+			[keyBlockHashes addEntriesFromDictionary:blockHashes];
+		}
+		[_keyBlockHashes release];
+		_keyBlockHashes = [keyBlockHashes copy];
 		
+		// Only the changed keys have to be indexed again.
+		unindexedFingerprints = goneFingerprints;
+		indexedKeys = changedKeys;
 		
-		NSMutableDictionary *keysByKeyID = [[NSMutableDictionary alloc] init];
-		NSMutableSet *secretKeys = [[NSMutableSet alloc] init];
-		
-		for (GPGKey *key in _mutableAllKeys) {
-			if (key.secret) {
-				[secretKeys addObject:key];
-			}
-			[keysByKeyID setObject:key forKey:key.keyID];
-			for (GPGKey *subkey in key.subkeys) {
-				[keysByKeyID setObject:subkey forKey:subkey.keyID];
-			}
+		if (plainFullLoad && keyringStamp && secretListing) {
+			dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0), ^{
+				[GPGKeyringSnapshot writeSnapshotWithSecretListing:secretListing publicListing:publicListing keyringStamp:keyringStamp homedir:homedir];
+			});
 		}
 		
-		self.secretKeys = secretKeys;
-		[secretKeys release];
 		
-		self.keysByKeyID = keysByKeyID;
+		
+		
+		// Publish the keys with all their indexes as a new keyring, unless nothing has changed.
+		// A full load from gpg also tells, that the keys match the current keyring files. After a partial
+		// load, they only do so if the files didn't change since the last full load.
+		NSData *newKeyringStamp = keys ? _keyring.keyringStamp : keyringStamp;
+		if (!_keyring || changedKeys.count > 0 || goneFingerprints.count > 0 ||
+			(newKeyringStamp != _keyring.keyringStamp && ![newKeyringStamp isEqualToData:_keyring.keyringStamp])) {
+			newKeyring = [[GPGKeyring alloc] initWithKeys:_mutableAllKeys generation:_keyring.generation + 1 keyringStamp:newKeyringStamp];
+		}
 		if (fetchSignatures) {
-			for (GPGKey *key in _mutableAllKeys) {
+			// Only the new keys get their signers. The published keys are never changed.
+			NSDictionary *keysByKeyID = newKeyring.keysByKeyID;
+			for (GPGKey *key in changedKeys) {
 				for (GPGUserID *uid in key.userIDs) {
-					for (GPGUserIDSignature *sig in uid.signatures) {
+					NSArray *signatures = uid.signatures;
+					if ([signatures isKindOfClass:[GPGSignatureList class]]) {
+						// Set the keys used to create the signatures without creating every GPGUserIDSignature.
+						[(GPGSignatureList *)signatures setSignersFromKeysByKeyID:keysByKeyID];
+						continue;
+					}
+					for (GPGUserIDSignature *sig in signatures) {
 						sig.primaryKey = [keysByKeyID objectForKey:sig.keyID]; // Set the key used to create the signature.
 					}
 				}
 			}
 		}
-		[keysByKeyID release];
 
 				
 	}
@@ -369,7 +579,28 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 		//TODO: Detect unavailable keyring.
 		
 		GPGDebugLog(@"loadKeys failed: %@", exception);
-		_mutableAllKeys = nil;
+		indexedKeys = nil;
+		unindexedFingerprints = nil;
+		addedFingerprints = nil;
+		modifiedFingerprints = nil;
+		removedFingerprints = nil;
+		[newKeyring release];
+		newKeyring = nil;
+		if (keys) {
+			// Only some keys were loaded, e.g. for a signature fault. Keep the current keyring,
+			// the faults can be tried again.
+			keysChanged = NO;
+			@synchronized (_signatureFaults) {
+				[_signatureFaults removeAllObjects];
+			}
+		} else {
+			for (GPGKey *key in _mutableAllKeys) {
+				key.keyManager = nil;
+			}
+			[_mutableAllKeys removeAllObjects];
+			clearSearchIndex = YES;
+			newKeyring = [[GPGKeyring alloc] initWithKeys:nil generation:_keyring.generation + 1];
+		}
 #ifdef DEBUGGING
 		if ([exception respondsToSelector:@selector(errorCode)] && [(GPGException *)exception errorCode] != GPGErrorNotFound) {
 			@throw exception;
@@ -380,51 +611,67 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 		[_secKeyInfos release];
 		_secKeyInfos = nil;
 		
-		NSSet *oldAllKeys = _allKeys;
-		_allKeys = [_mutableAllKeys copy];
-		[oldAllKeys release];
+		// Readers see either the old or the new keyring, never a mix of both.
+		// The search index is changed together with the keyring, so a search only finds keys of the current one.
+		if (newKeyring) {
+			@synchronized (_searchIndex) {
+				if (clearSearchIndex) {
+					[_searchIndex removeAllKeys];
+				}
+				for (NSString *fingerprint in unindexedFingerprints) {
+					[_searchIndex removeKeyWithFingerprint:fingerprint];
+				}
+				for (GPGKey *key in indexedKeys) {
+					[_searchIndex addKey:key];
+				}
+				self.currentKeyring = newKeyring;
+			}
+			[newKeyring release];
+		}
 	}
 	
-	// Inform all listeners that the keys were loaded.
-	dispatch_async(dispatch_get_main_queue(), ^{
-		NSArray *affectedKeys = [[[newKeysSet setByAddingObjectsFromSet:keys] valueForKey:@"description"] allObjects];
-		NSDictionary *userInfo = nil;
-		if (affectedKeys) {
-			userInfo = [NSDictionary dictionaryWithObject:affectedKeys forKey:@"affectedKeys"];
-		}
-		
-		[[NSNotificationCenter defaultCenter] postNotificationName:GPGKeyManagerKeysDidChangeNotification object:[[self class] description] userInfo:userInfo];
-		
-#warning Remove the NSDistributedNotificationCenter line in the next version. It's only for compatibility.
-		[[NSDistributedNotificationCenter defaultCenter] postNotificationName:GPGKeyManagerKeysDidChangeNotification object:[[self class] description] userInfo:userInfo];
-	});
+	// Inform all listeners that the keys were loaded. Loads of signatures don't change the keyring on disk,
+	// so other processes aren't told.
+	if (keysChanged) {
+		BOOL distributed = !(keys && fetchSignatures);
+		[self postKeysDidChangeNotificationWithAddedKeys:addedFingerprints removedKeys:removedFingerprints modifiedKeys:modifiedFingerprints distributed:distributed];
+	}
 
+	// The keys from the snapshot might be outdated in ways the keyring stamp can't detect,
+	// e.g. expired keys or a different gpg version. Reconcile with gpg.
+	if (snapshot) {
+		[self _queueLoadKeys:nil fetchSignatures:NO fetchAttributes:NO sync:NO completionHandler:nil];
+	}
+	
 	// Start the key ring watcher.
 	[self startKeyringWatcher];
 }
 
-- (void)fillKey:(GPGKey *)primaryKey withRange:(NSRange)lineRange {
+- (void)fillKey:(GPGKey *)primaryKey fromListing:(GPGColonListing *)listing range:(NSRange)lineRange {
 	
-	NSMutableArray *userIDs = nil, *subkeys = nil, *signatures = nil;
+	NSMutableArray *userIDs = nil, *subkeys = nil;
+	GPGSignatureList *signatures = nil;
 	GPGKey *key = nil;
 	GPGKey *signedObject = nil; // A GPGUserID or GPGKey.
 	
-	GPGUserIDSignature *signature = nil;
+	GPGPackedSignature *signature = NULL; // Only valid until the next signature is added to signatures.
 	BOOL isPub = NO, isUid = NO, isRev = NO; // Used to differentiate pub/sub, uid/uat and sig/rev, because they are using the same if branch.
 	NSUInteger uatIndex = 0;
 	
 	
 	NSUInteger i = lineRange.location;
 	NSUInteger end = i + lineRange.length;
+	GPGColonRecord record;
+	const GPGColonRecord *parts = &record;
 	
 	for (; i < end; i++) {
-		NSArray *parts = [[_keyLines objectAtIndex:i] componentsSeparatedByString:@":"];
-		NSString *type = [parts objectAtIndex:0];
+		[listing getRecord:&record atLine:i];
 		
-		if (([type isEqualToString:@"pub"] && (isPub = YES)) || [type isEqualToString:@"sub"]) { // Primary-key or subkey.
+		if ((GPGColonRecordHasType(parts, "pub") && (isPub = YES)) || GPGColonRecordHasType(parts, "sub")) { // Primary-key or subkey.
 			if (_fetchSignatures) {
 				signedObject.signatures = signatures;
-				signatures = [NSMutableArray array];
+				signatures = [GPGSignatureList list];
+				signature = NULL;
 			}
 			if (isPub) {
 				key = primaryKey;
@@ -434,27 +681,28 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 			signedObject = key;
 			
 			
-			GPGValidity validity = [self validityForLetter:[parts objectAtIndex:1]];
+			GPGValidity validity = GPGColonFieldValidity(GPGColonRecordField(parts, 1));
 			
-			key.length = [[parts objectAtIndex:2] intValue];
+			key.length = (int)GPGColonFieldInteger(GPGColonRecordField(parts, 2));
 			
-			key.algorithm = [[parts objectAtIndex:3] intValue];
+			key.algorithm = (int)GPGColonFieldInteger(GPGColonRecordField(parts, 3));
 			
-			key.keyID = [parts objectAtIndex:4];
+			GPGColonField keyIDField = GPGColonRecordField(parts, 4);
+			key.keyID = GPGInternedStringWithBytes(keyIDField.bytes, keyIDField.length);
 			
-			key.creationDate = [NSDate dateWithGPGString:[parts objectAtIndex:5]];
+			key.creationDate = GPGColonFieldDate(GPGColonRecordField(parts, 5));
 			
-			NSDate *expirationDate = [NSDate dateWithGPGString:[parts objectAtIndex:6]];
+			NSDate *expirationDate = GPGColonFieldDate(GPGColonRecordField(parts, 6));
 			key.expirationDate = expirationDate;
 			if (!(validity & GPGValidityExpired) && expirationDate && [[NSDate date] isGreaterThanOrEqualTo:expirationDate]) {
 				validity |= GPGValidityExpired;
 			}
 			
-			key.ownerTrust = [self validityForLetter:[parts objectAtIndex:8]];
+			key.ownerTrust = GPGColonFieldValidity(GPGColonRecordField(parts, 8));
 			
-			const char *capabilities = [[parts objectAtIndex:11] UTF8String];
-			for (; *capabilities; capabilities++) {
-				switch (*capabilities) {
+			GPGColonField capabilities = GPGColonRecordField(parts, 11);
+			for (NSUInteger j = 0; j < capabilities.length; j++) {
+				switch (capabilities.bytes[j]) {
 					case 'd':
 					case 'D':
 						validity |= GPGValidityDisabled;
@@ -495,10 +743,11 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 			key.primaryKey = primaryKey;
 			
 		}
-		else if (([type isEqualToString:@"uid"] && (isUid = YES)) || [type isEqualToString:@"uat"]) { // UserID or UAT (PhotoID).
+		else if ((GPGColonRecordHasType(parts, "uid") && (isUid = YES)) || GPGColonRecordHasType(parts, "uat")) { // UserID or UAT (PhotoID).
 			if (_fetchSignatures) {
 				signedObject.signatures = signatures;
-				signatures = [NSMutableArray array];
+				signatures = [GPGSignatureList list];
+				signature = NULL;
 			}
 
 			GPGUserID *userID = [[[GPGUserID alloc] init] autorelease];
@@ -506,20 +755,22 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 			signedObject = (GPGKey *)userID; // signedObject is a GPGKey or GPGUserID. It's only casted to allow "signedObject.signatures = signatures".
 			
 			
-			GPGValidity validity = [self validityForLetter:[parts objectAtIndex:1]];
+			GPGValidity validity = GPGColonFieldValidity(GPGColonRecordField(parts, 1));
 			
-			userID.creationDate = [NSDate dateWithGPGString:[parts objectAtIndex:5]];
+			userID.creationDate = GPGColonFieldDate(GPGColonRecordField(parts, 5));
 			
-			NSDate *expirationDate = [NSDate dateWithGPGString:[parts objectAtIndex:6]];
+			NSDate *expirationDate = GPGColonFieldDate(GPGColonRecordField(parts, 6));
 			userID.expirationDate = expirationDate;
 			if (!(validity & GPGValidityExpired) && expirationDate && [[NSDate date] isGreaterThanOrEqualTo:expirationDate]) {
 				validity |= GPGValidityExpired;
 			}
 			
-			userID.hashID = [parts objectAtIndex:7];
+			GPGColonField hashIDField = GPGColonRecordField(parts, 7);
+			userID.hashID = GPGInternedStringWithBytes(hashIDField.bytes, hashIDField.length);
 			
 			
-			if (parts.count > 11 && [[parts objectAtIndex:11] rangeOfString:@"D"].length > 0) {
+			GPGColonField capabilities = GPGColonRecordField(parts, 11);
+			if (memchr(capabilities.bytes, 'D', capabilities.length)) {
 				validity |= GPGValidityDisabled;
 			}
 			
@@ -528,7 +779,7 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 			
 			if (isUid) {
 				isUid = NO;
-				NSDictionary *dict = [[[parts objectAtIndex:9] unescapedString] splittedUserIDDescription];
+				NSDictionary *dict = [GPGColonFieldUnescapedString(GPGColonRecordField(parts, 9)) splittedUserIDDescription];
 				userID.userIDDescription = [dict objectForKey:@"userIDDescription"];
 				userID.name = [dict objectForKey:@"name"];
 				userID.email = [dict objectForKey:@"email"];
@@ -555,22 +806,10 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 							
 							switch (uatType) {
 								case 1: { // Image
-									NSImage *image = [[NSImage alloc] initWithData:[_attributeData subdataWithRange:NSMakeRange(location + 16, length - 16)]];
-									
-									if (image) {
-										NSImageRep *imageRep = [[image representations] objectAtIndex:0];
-										NSSize size = imageRep.size;
-										if (size.width != imageRep.pixelsWide || size.height != imageRep.pixelsHigh) { // Fix image size if needed.
-											size.width = imageRep.pixelsWide;
-											size.height = imageRep.pixelsHigh;
-											imageRep.size = size;
-											[image setSize:size];
-										}
-										
-										userID.image = image;
-										[image release];
+									// Only the JPEG data is kept. The image is decoded by GPGImageCache, when it's used.
+									if (length > 16) {
+										userID.imageData = [_attributeData subdataWithRange:NSMakeRange(location + 16, length - 16)];
 									}
-									
 									break;
 								}
 							}
@@ -584,10 +823,13 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 			
 			[userIDs addObject:userID];
 		}
-		else if ([type isEqualToString:@"fpr"]) { // Fingerprint.
-			NSString *fingerprint = [parts objectAtIndex:9];
-			if ([fingerprint isEqualToString:@"00000000000000000000000000000000"]) {
+		else if (GPGColonRecordHasType(parts, "fpr")) { // Fingerprint.
+			NSString *fingerprint;
+			GPGColonField field = GPGColonRecordField(parts, 9);
+			if (GPGColonFieldIsEqual(field, "00000000000000000000000000000000")) {
 				fingerprint = primaryKey.keyID;
+			} else {
+				fingerprint = GPGInternedStringWithBytes(field.bytes, field.length);
 			}
 			
 			key.fingerprint = fingerprint;
@@ -599,58 +841,65 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 				key.cardID = cardID;
 			}
 		}
-		else if ([type isEqualToString:@"sig"] || ([type isEqualToString:@"rev"] && (isRev = YES))) { // Signature.
-			signature = [[[GPGUserIDSignature alloc] init] autorelease];
+		else if (GPGColonRecordHasType(parts, "grp")) { // Keygrip. Follows the fpr record of the key or subkey.
+			GPGColonField field = GPGColonRecordField(parts, 9);
+			if (field.length > 0) {
+				key.keygrip = GPGInternedStringWithBytes(field.bytes, field.length);
+			}
+		}
+		else if (signatures && (GPGColonRecordHasType(parts, "sig") || (GPGColonRecordHasType(parts, "rev") && (isRev = YES)))) { // Signature.
+			signature = [signatures addSignatureWithKeyID:GPGColonRecordField(parts, 4)];
 			
-			NSString *validityString = parts[1];
-			if (validityString.length == 1) {
-				unichar character = [validityString characterAtIndex:0];
-				switch (character) {
+			GPGColonField validityField = GPGColonRecordField(parts, 1);
+			if (validityField.length == 1) {
+				switch (validityField.bytes[0]) {
 					case '!':
-						signature.validity = GPGValidityUltimate;
+						signature->validity = GPGValidityUltimate;
 						break;
 					case '?':
-						signature.validity = GPGValidityUndefined;
+						signature->validity = GPGValidityUndefined;
 						break;
 					case '-':
-						signature.validity = GPGValidityNever;
+						signature->validity = GPGValidityNever;
 						break;
 					case '%':
-						signature.validity = GPGValidityInvalid;
+						signature->validity = GPGValidityInvalid;
 						break;
 				}
 			}
 			
-			signature.revocation = isRev;
-			
-			signature.algorithm = [parts[3] intValue];
-			
-			signature.keyID = parts[4];
+			if (isRev) {
+				signature->flags |= GPGPackedSignatureRevocation;
+			}
 			
-			signature.creationDate = [NSDate dateWithGPGString:parts[5]];
+			signature->algorithm = (uint8_t)GPGColonFieldInteger(GPGColonRecordField(parts, 3));
 			
-			signature.expirationDate = [NSDate dateWithGPGString:parts[6]];
+			signature->creationDate = GPGColonFieldTimestamp(GPGColonRecordField(parts, 5));
 			
-			NSString *field = parts[10];
-			signature.signatureClass = hexToByte(field.UTF8String);
-			signature.local = [field hasSuffix:@"l"];
+			signature->expirationDate = GPGColonFieldTimestamp(GPGColonRecordField(parts, 6));
 			
-			if (parts.count > 15) {
-				signature.hashAlgorithm = [parts[15] intValue];
+			GPGColonField field = GPGColonRecordField(parts, 10);
+			signature->signatureClass = field.length >= 2 ? hexToByte(field.bytes) : -1;
+			if (field.length > 0 && field.bytes[field.length - 1] == 'l') {
+				signature->flags |= GPGPackedSignatureLocal;
 			}
 			
-			[signatures addObject:signature];
+			if (parts->count > 15) {
+				signature->hashAlgorithm = (uint8_t)GPGColonFieldInteger(GPGColonRecordField(parts, 15));
+			}
 			
 			isRev = NO;
 		}
-		else if ([type isEqualToString:@"spk"]) { // Signature subpacket. Needed for the revocation reason.
-			switch ([[parts objectAtIndex:1] integerValue]) {
+		else if (GPGColonRecordHasType(parts, "spk") && signature) { // Signature subpacket. Needed for the revocation reason.
+			switch (GPGColonFieldInteger(GPGColonRecordField(parts, 1))) {
 				case 29:
-					signature.reason = [[parts objectAtIndex:4] unescapedString];
+					[signatures setReason:GPGColonFieldUnescapedString(GPGColonRecordField(parts, 4)) forSignature:signature];
 					break;
 				case 30: {
-					NSString *value = parts[4];
-					signature.mdcSupport = value.length > 2 && [[value substringToIndex:3] isEqualToString:@"%01"];
+					GPGColonField value = GPGColonRecordField(parts, 4);
+					if (value.length > 2 && memcmp(value.bytes, "%01", 3) == 0) {
+						signature->flags |= GPGPackedSignatureMDCSupport;
+					}
 					break;
 				}
 			}
@@ -684,15 +933,93 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 	[subkeys release];
 }
 
+#pragma mark Signature faults
+
+- (void)loadSignaturesOfKeyIfNeeded:(GPGKey *)key {
+	key = key.primaryKey ? key.primaryKey : key;
+	NSString *fingerprint = key.fingerprint;
+	if (!fingerprint || [self.currentKeyring.allKeys member:key] != key) {
+		// Not a key of the keyring, or replaced by a newer instance. Keys being parsed aren't published yet.
+		return;
+	}
+	@synchronized (_signatureFaults) {
+		if ([_signatureFaults containsObject:fingerprint]) {
+			return;
+		}
+		[_signatureFaults addObject:fingerprint];
+	}
+	
+	// The key is replaced by a new instance. Load the photos again, if the key has them.
+	BOOL fetchAttributes = NO;
+	for (GPGUserID *userID in key.userIDs) {
+		if (userID.imageData) {
+			fetchAttributes = YES;
+			break;
+		}
+	}
+	
+	// Queued loads of selected keys are combined, so simultaneous faults share one gpg call.
+	[self _queueLoadKeys:[NSSet setWithObject:fingerprint] fetchSignatures:YES fetchAttributes:fetchAttributes sync:NO completionHandler:^{
+		@synchronized (_signatureFaults) {
+			[_signatureFaults removeObject:fingerprint];
+		}
+	}];
+}
+
+/*
+ * Posts GPGKeyManagerKeysDidChangeNotification on the main queue. Must be called on _keyLoadingQueue.
+ * The arrays contain fingerprints. If they are nil, every key might have changed.
+ */
+- (void)postKeysDidChangeNotificationWithAddedKeys:(NSArray *)added removedKeys:(NSArray *)removed modifiedKeys:(NSArray *)modified distributed:(BOOL)distributed {
+	NSMutableDictionary *userInfo = [NSMutableDictionary dictionaryWithObject:@(_keyring.generation) forKey:GPGKeyManagerGenerationKey];
+	NSDictionary *distributedUserInfo = nil;
+	
+	if (added && removed && modified) {
+		NSArray *affected = [[added arrayByAddingObjectsFromArray:removed] arrayByAddingObjectsFromArray:modified];
+		[userInfo setObject:added forKey:GPGKeyManagerAddedKeysKey];
+		[userInfo setObject:removed forKey:GPGKeyManagerRemovedKeysKey];
+		[userInfo setObject:modified forKey:GPGKeyManagerModifiedKeysKey];
+		[userInfo setObject:affected forKey:GPGKeyManagerAffectedKeysKey];
+		
+		// Distributed notifications are serialized for every listening process. Only send the old
+		// affectedKeys, and only if they are few.
+		if (affected.count <= DISTRIBUTED_AFFECTED_KEYS_LIMIT) {
+			distributedUserInfo = [NSDictionary dictionaryWithObject:affected forKey:GPGKeyManagerAffectedKeysKey];
+		}
+	}
+	
+	// The shared instance keeps posting the class name as object, as it always did.
+	id object = self == sharedInstance ? [[self class] description] : self;
+	// Other processes only know the keyring of the shared instance.
+	distributed = distributed && self == sharedInstance;
+	
+	dispatch_async(dispatch_get_main_queue(), ^{
+		[[NSNotificationCenter defaultCenter] postNotificationName:GPGKeyManagerKeysDidChangeNotification object:object userInfo:userInfo];
+		
+		if (distributed) {
+#warning Remove the NSDistributedNotificationCenter line in the next version. It's only for compatibility.
+			[[NSDistributedNotificationCenter defaultCenter] postNotificationName:GPGKeyManagerKeysDidChangeNotification object:[[self class] description] userInfo:distributedUserInfo];
+		}
+	});
+}
+
 - (void)startKeyringWatcher {
     // The keyring watcher is only to be started after all the keys have
     // been loaded at least once.
     // In order to make sure of that, this method is always called after loadAllKeys
     // has completed, but using dispatch_once we'll also make sure that it's only started
     // once.
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        [GPGWatcher activate];
+    dispatch_once(&_watcherOnce, ^{
+		if (self == sharedInstance) {
+			[GPGWatcher activate];
+			return;
+		}
+		
+		// Other key managers watch their own homedir. Its changes are only interesting for this key manager,
+		// so the watcher posts to the local notification center.
+		_watcher = [[GPGWatcher alloc] initWithGpgHome:[_homedir stringByStandardizingPath]];
+		_watcher.notificationCenter = [NSNotificationCenter defaultCenter];
+		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(keysDidChange:) name:GPGKeysChangedNotification object:_watcher.identifier];
     });
 }
 
@@ -711,7 +1038,7 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 			
 			// All requested extras should be available for the keys.
 			// Now let's get them via their fingerprint.
-			NSSet *keysWithSignatures = [weakSelf->_allKeys objectsPassingTest:^BOOL(GPGKey *key, BOOL *stop) {
+			NSSet *keysWithSignatures = [weakSelf.currentKeyring.allKeys objectsPassingTest:^BOOL(GPGKey *key, BOOL *stop) {
 				return [fingerprints containsObject:[key description]];
 			}];
 			
@@ -728,63 +1055,79 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 
 #pragma mark Properties
 
-- (NSDictionary *)keysByKeyID {
-	static dispatch_once_t onceToken;
-	dispatch_once(&onceToken, ^{
-		if(!_keysByKeyID)
+- (GPGKeyring *)keyring {
+	dispatch_once(&_keyringOnce, ^{
+		if (!self.currentKeyring)
 			[self loadAllKeys];
 	});
 	
-	return [[_keysByKeyID retain] autorelease];
+	return self.currentKeyring;
+}
+
+- (NSUInteger)keyringGeneration {
+	return self.keyring.generation;
 }
 
 - (NSSet *)allKeys {
-	static dispatch_once_t onceToken;
-	dispatch_once(&onceToken, ^{
-		if(!_allKeys)
-			[self loadAllKeys];
-	});
-	
-	return [[_allKeys retain] autorelease];
+	return self.keyring.allKeys;
 }
 
 - (NSSet *)allKeysAndSubkeys {
-	/* TODO: Must be declared __weak once ARC! */
-	static id oldAllKeys = (id)1;
-	
-	dispatch_semaphore_wait(_allKeysAndSubkeysOnce, DISPATCH_TIME_FOREVER);
-	
-	NSSet *allKeys = self.allKeys;
-	
-	if (oldAllKeys != allKeys) {
-		oldAllKeys = allKeys;
-		
-		NSMutableSet *allKeysAndSubkeys = [[NSMutableSet alloc] initWithSet:allKeys copyItems:NO];
-		
-		for (GPGKey *key in allKeys) {
-			[allKeysAndSubkeys addObjectsFromArray:key.subkeys];
-		}
-		
-		id old = _allKeysAndSubkeys;
-		_allKeysAndSubkeys = [allKeysAndSubkeys copy];
-		[old release];
-		[allKeysAndSubkeys release];
+	return self.keyring.allKeysAndSubkeys;
+}
+
+- (NSSet *)secretKeys {
+	return self.keyring.secretKeys;
+}
+
+- (NSDictionary *)keysByKeyID {
+	return self.keyring.keysByKeyID;
+}
+
+- (NSDictionary *)keysByFingerprint {
+	return self.keyring.keysByFingerprint;
+}
+
+- (NSDictionary *)keysByKeygrip {
+	return self.keyring.keysByKeygrip;
+}
+
+- (NSDictionary *)keysByEmail {
+	return self.keyring.keysByEmail;
+}
+
+- (NSDictionary *)keysByUserIDHash {
+	return self.keyring.keysByUserIDHash;
+}
+
+- (NSArray *)keysForEmail:(NSString *)email {
+	NSString *normalized = [GPGKeyring normalizedEmail:email];
+	if (!normalized) {
+		return @[];
 	}
-	
-	dispatch_semaphore_signal(_allKeysAndSubkeysOnce);
+	NSArray *keys = [self.keysByEmail objectForKey:normalized];
+	return keys ? keys : @[];
+}
 
-	return [[_allKeysAndSubkeys retain] autorelease];
+- (NSSet *)keysMatchingSearchString:(NSString *)searchString {
+	// Load the keys, if not already done.
+	[self keyring];
+	@synchronized (_searchIndex) {
+		return [_searchIndex keysMatchingSearchString:searchString];
+	}
 }
 
-- (NSSet *)secretKeys {
-	static dispatch_once_t onceToken;
-	dispatch_once(&onceToken, ^{
-		if (!_secretKeys) {
-			[self loadAllKeys];
-		}
-	});
-	
-	return [[_secretKeys retain] autorelease];
+- (GPGKey *)upToDateKeyWithFingerprint:(NSString *)fingerprint {
+	GPGKeyring *keyring = self.currentKeyring;
+	if (!keyring.keyringStamp || !fingerprint) {
+		return nil;
+	}
+	NSString *homedir = _homedir ? _homedir : [GPGOptions sharedOptions].gpgHome;
+	if (![[GPGKeyringSnapshot keyringStampForHomedir:homedir] isEqualToData:keyring.keyringStamp]) {
+		return nil;
+	}
+	GPGKey *key = [keyring.keysByFingerprint objectForKey:fingerprint];
+	return key.primaryKey ? key.primaryKey : key;
 }
 
 - (void)setCompletionQueue:(dispatch_queue_t)completionQueue {
@@ -844,7 +1187,7 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 			if (keyID.length == 16) {
 				realKey = self.keysByKeyID[keyID];
 			} else {
-				realKey = [self.allKeysAndSubkeys member:key];
+				realKey = [self.keysByFingerprint objectForKey:key];
 			}
 			
 			if (!realKey) {
@@ -900,53 +1243,65 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 
 #pragma mark Helper methods
 
-- (GPGValidity)validityForLetter:(NSString *)letter {
-	if ([letter length] == 0) {
-		return GPGValidityUnknown;
+- (NSString *)fingerprintOfKeyInListing:(GPGColonListing *)listing range:(NSRange)lineRange {
+	GPGColonRecord record;
+	NSUInteger end = lineRange.location + lineRange.length;
+	
+	for (NSUInteger i = lineRange.location; i < end; i++) {
+		if ([listing line:i hasType:"fpr"]) {
+			[listing getRecord:&record atLine:i];
+			GPGColonField field = GPGColonRecordField(&record, 9);
+			if (!GPGColonFieldIsEqual(field, "00000000000000000000000000000000")) {
+				return GPGColonFieldString(field);
+			}
+			break;
+		}
 	}
-	switch ([letter characterAtIndex:0]) {
-		case 'q':
-			return GPGValidityUndefined;
-		case 'n':
-			return GPGValidityNever;
-		case 'm':
-			return GPGValidityMarginal;
-		case 'f':
-			return GPGValidityFull;
-		case 'u':
-			return GPGValidityUltimate;
-		case 'i':
-			return GPGValidityInvalid;
-		case 'r':
-			return GPGValidityRevoked;
-		case 'e':
-			return GPGValidityExpired;
-		case 'd':
-			return GPGValidityDisabled;
+	
+	// Same as fillKey:fromListing:range: for keys without fingerprint.
+	[listing getRecord:&record atLine:lineRange.location];
+	return GPGColonFieldString(GPGColonRecordField(&record, 4));
+}
+
+- (NSNumber *)hashOfKeyInListing:(GPGColonListing *)listing range:(NSRange)lineRange {
+	uint64_t hash = [listing hashOfLinesInRange:lineRange];
+	
+	// The secret flag and the card ID come from the secret listing, so they have to be part of the hash.
+	GPGColonRecord record;
+	NSUInteger end = lineRange.location + lineRange.length;
+	for (NSUInteger i = lineRange.location; i < end; i++) {
+		if ([listing line:i hasType:"fpr"]) {
+			[listing getRecord:&record atLine:i];
+			NSDictionary *secKeyInfo = [_secKeyInfos objectForKey:GPGColonFieldString(GPGColonRecordField(&record, 9))];
+			if (secKeyInfo) {
+				hash = (hash ^ ([[secKeyInfo objectForKey:@"cardID"] hash] + 1)) * 1099511628211ULL;
+			}
+		}
 	}
-	return GPGValidityUnknown;
+	
+	return [NSNumber numberWithUnsignedLongLong:hash];
 }
 
-- (NSDictionary *)parseSecColonListing:(NSArray *)lines {
+- (NSDictionary *)parseSecColonListing:(GPGColonListing *)listing {
 	NSMutableDictionary *infos = [NSMutableDictionary dictionary];
-	NSUInteger count = lines.count;
+	NSUInteger count = listing.lineCount;
+	GPGColonRecord record;
 	
 	NSDictionary *keyInfo = @{};
 	
 	
-	for (NSInteger i = 0; i < count; i++) { // Loop backwards through the lines.
-		NSArray *parts = [[lines objectAtIndex:i] componentsSeparatedByString:@":"];
-		NSString *type = [parts objectAtIndex:0];
+	for (NSInteger i = 0; i < count; i++) {
+		[listing getRecord:&record atLine:i];
 		
-		if ([type isEqualToString:@"sec"] || [type isEqualToString:@"ssb"]) {
-			NSString *cardID = [parts objectAtIndex:14];
+		if (GPGColonRecordHasType(&record, "sec") || GPGColonRecordHasType(&record, "ssb")) {
+			GPGColonField cardID = GPGColonRecordField(&record, 14);
 			if (cardID.length > 0) {
-				keyInfo = @{@"cardID":cardID};
+				keyInfo = @{@"cardID":GPGColonFieldString(cardID)};
 			} else {
 				keyInfo = @{};
 			}
-		} else if ([type isEqualToString:@"fpr"]) {
-			NSString *fingerprint = [parts objectAtIndex:9];
+		} else if (GPGColonRecordHasType(&record, "fpr")) {
+			NSString *fingerprint = GPGColonFieldString(GPGColonRecordField(&record, 9));
 			[infos setObject:keyInfo forKey:fingerprint];
 		}
 	}
@@ -1009,76 +1364,156 @@ NSString * const GPGKeyManagerKeysDidChangeNotification = @"GPGKeyManagerKeysDid
 	// Because of security concerns, simply ignore the list of keys and
 	// rebuild all of them.
 	
-	// We're on the main queue, so we should use asnyc loading.
-	[self _queueLoadKeys:nil fetchSignatures:NO fetchAttributes:NO sync:NO completionHandler:nil];
+	// Imports and other bulk operations post many notifications in a short time.
+	// Wait until they stop, but not longer than KEYS_CHANGED_MAX_DELAY, and load the keys only once.
+	dispatch_async(_keyChangeNotificationQueue, ^{
+		NSUInteger generation = ++_keysChangedGeneration;
+		if (_firstKeysChangedTime == 0) {
+			_firstKeysChangedTime = CFAbsoluteTimeGetCurrent();
+		}
+		
+		dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(KEYS_CHANGED_DELAY * NSEC_PER_SEC)), _keyChangeNotificationQueue, ^{
+			if (_firstKeysChangedTime == 0) {
+				// Already loaded by an earlier block.
+				return;
+			}
+			if (generation != _keysChangedGeneration && CFAbsoluteTimeGetCurrent() - _firstKeysChangedTime < KEYS_CHANGED_MAX_DELAY) {
+				// There was another notification, its block loads the keys.
+				return;
+			}
+			_firstKeysChangedTime = 0;
+			
+			// Use asnyc loading, this is only a notification.
+			[self _queueLoadKeys:nil fetchSignatures:NO fetchAttributes:NO sync:NO completionHandler:nil];
+		});
+	});
 }
 
 
 
-#pragma mark Singleton
+#pragma mark Init and singleton
 
 + (GPGKeyManager *)sharedInstance {
 	static dispatch_once_t onceToken;
-    static GPGKeyManager *sharedInstance;
     
     dispatch_once(&onceToken, ^{
-        sharedInstance = [[super allocWithZone:nil] realInit];
+        sharedInstance = [[self alloc] initWithHomedir:nil shared:YES];
     });
     
     return sharedInstance;
 }
 
-- (id)realInit {
+- (instancetype)initWithHomedir:(NSString *)homedir {
+	return [self initWithHomedir:homedir shared:NO];
+}
+
+- (instancetype)initWithHomedir:(NSString *)homedir shared:(BOOL)shared {
 	if (!(self = [super init])) {
 		return nil;
 	}
 	
-	// Repair the config if needed.
-	[[GPGOptions sharedOptions] repairGPGConf];
+	_homedir = [homedir copy];
+	if (shared) {
+		// Repair the config if needed.
+		[[GPGOptions sharedOptions] repairGPGConf];
+	}
 
 	_mutableAllKeys = [[NSMutableSet alloc] init];
+	_searchIndex = [[GPGKeySearchIndex alloc] init];
 	_keyLoadingQueue = dispatch_queue_create("org.gpgtools.libmacgpg.GPGKeyManager.key-loader", NULL);
+	_signatureFaults = [[NSMutableSet alloc] init];
 	_keyChangeNotificationQueue = dispatch_queue_create("org.gpgtools.libmacgpg.GPGKeyManager.key-change", NULL);
-	// Start listening to keyring modifications notifcations.
-	[[NSDistributedNotificationCenter defaultCenter] addObserver:self selector:@selector(keysDidChange:) name:GPGKeysChangedNotification object:nil];
+	if (shared) {
+		// Start listening to keyring modifications notifcations.
+		// Other key managers listen to their own watcher, once it's started.
+		[[NSDistributedNotificationCenter defaultCenter] addObserver:self selector:@selector(keysDidChange:) name:GPGKeysChangedNotification object:nil];
+	}
 	_completionQueue = NULL;
 	
-	_allKeysAndSubkeysOnce = dispatch_semaphore_create(1);
 
 	
 	_keyLoadingOperations = [[NSMutableArray alloc] init];
 	_keyLoadingOperationsLock = dispatch_queue_create("org.gpgtools.libmacgpg.GPGKeyManager.key-loader-lock", NULL);
 
-	[GPGKeyMonitoring sharedInstance];
+	if (shared) {
+		[GPGKeyMonitoring sharedInstance];
+	}
 	
 	return self;
 }
 
-+ (id)allocWithZone:(NSZone *)zone {
-    return [[self sharedInstance] retain];
+- (id)init {
+	// GPGKeyManager used to be a singleton only. [[GPGKeyManager alloc] init] still returns the shared instance.
+	[self release];
+	return [[GPGKeyManager sharedInstance] retain];
 }
 
-- (id)init {
-	return self;
+- (void)dealloc {
+	[[NSNotificationCenter defaultCenter] removeObserver:self];
+	[[NSDistributedNotificationCenter defaultCenter] removeObserver:self];
+	
+	for (GPGKey *key in _mutableAllKeys) {
+		key.keyManager = nil;
+	}
+	
+	[_homedir release];
+	[_keyring release];
+	[_mutableAllKeys release];
+	[_searchIndex release];
+	[_watcher release];
+	[_signatureFaults release];
+	[_keyLoadingOperations release];
+	[_keyBlockHashes release];
+	[_secretListing release];
+	[_secretListingStamp release];
+	if (_keyLoadingQueue) {
+		dispatch_release(_keyLoadingQueue);
+	}
+	if (_keyChangeNotificationQueue) {
+		dispatch_release(_keyChangeNotificationQueue);
+	}
+	if (_keyLoadingOperationsLock) {
+		dispatch_release(_keyLoadingOperationsLock);
+	}
+	if (_completionQueue) {
+		dispatch_release(_completionQueue);
+	}
+	
+	[super dealloc];
 }
 
 - (id)copyWithZone:(NSZone *)zone {
-    return self;
+    return [self retain];
 }
 
+// The shared instance is never released.
+
 - (id)retain {
-    return self;
+	if (self == sharedInstance) {
+		return self;
+	}
+	return [super retain];
 }
 
 - (NSUInteger)retainCount {
-    return NSUIntegerMax;
+	if (self == sharedInstance) {
+		return NSUIntegerMax;
+	}
+	return [super retainCount];
 }
 
 - (oneway void)release {
+	if (self == sharedInstance) {
+		return;
+	}
+	[super release];
 }
 
 - (id)autorelease {
-    return self;
+	if (self == sharedInstance) {
+		return self;
+	}
+	return [super autorelease];
 }
 
 
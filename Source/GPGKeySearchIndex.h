@@ -0,0 +1,43 @@
+//
+//  GPGKeySearchIndex.h
+//  Libmacgpg
+//
+
+#import <Foundation/Foundation.h>
+
+@class GPGKey;
+
+/*
+ * A trigram index over the textForFilter of keys, used by GPGKeyManager for type-ahead search.
+ *
+ * The text of every key is folded (case and diacritics) and split into all its 3 byte sequences.
+ * For every trigram the index keeps the sorted list of keys containing it.
+ * A search intersects the lists of the trigrams of the search string, starting with the shortest,
+ * and only compares the remaining candidates with the search string.
+ *
+ * Keys are identified by fingerprint. Adding a key with the fingerprint of an indexed key replaces it.
+ * Removed keys leave gaps in the lists, which are skipped. When there are more gaps than keys,
+ * the index is rebuilt.
+ *
+ * All methods are thread-safe.
+ */
+@interface GPGKeySearchIndex : NSObject {
+	void *_buckets; // Hash table of trigram -> posting list.
+	NSUInteger _bucketCount;
+	NSUInteger _usedBucketCount;
+
+	NSMutableArray *_keys; // Slot -> GPGKey, or NSNull for removed keys.
+	NSMutableArray *_texts; // Slot -> folded text as NSData.
+	NSMutableDictionary *_slotsByFingerprint;
+	NSUInteger _removedCount;
+}
+
+/* Adds key or replaces the key with the same fingerprint. */
+- (void)addKey:(GPGKey *)key;
+- (void)removeKeyWithFingerprint:(NSString *)fingerprint;
+- (void)removeAllKeys;
+
+/* All keys whose textForFilter contains searchString, ignoring case and diacritics. */
+- (NSSet *)keysMatchingSearchString:(NSString *)searchString;
+
+@end
@@ -0,0 +1,315 @@
+//
+//  GPGKeySearchIndex.m
+//  Libmacgpg
+//
+
+#import "GPGKeySearchIndex.h"
+#import "GPGKey.h"
+#import "GPGGlobals.h"
+
+// The bytes of a trigram are stored in the lower 24 bits. The marker bit makes sure no trigram is 0,
+// which marks an empty bucket.
+#define TRIGRAM_MARKER (1u << 24)
+#define TRIGRAM(bytes) (TRIGRAM_MARKER | ((uint32_t)(bytes)[0] << 16) | ((uint32_t)(bytes)[1] << 8) | (uint32_t)(bytes)[2])
+
+// Rebuild the index, when it contains more removed than live keys, but not for small indexes.
+#define MIN_REMOVED_FOR_REBUILD 1024
+
+typedef struct {
+	uint32_t trigram;
+	uint32_t count;
+	uint32_t capacity;
+	uint32_t *slots; // Ascending slot numbers of the keys containing the trigram.
+} GPGTrigramPosting;
+
+
+static NSUInteger bucketIndex(uint32_t trigram, NSUInteger bucketCount) {
+	return (trigram * 2654435761u) & (bucketCount - 1);
+}
+
+static NSData *foldedText(NSString *text) {
+	NSString *folded = [text stringByFoldingWithOptions:NSCaseInsensitiveSearch | NSDiacriticInsensitiveSearch locale:nil];
+	return [folded dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+
+@implementation GPGKeySearchIndex
+
+- (instancetype)init {
+	self = [super init];
+	if (!self) {
+		return nil;
+	}
+
+	_keys = [[NSMutableArray alloc] init];
+	_texts = [[NSMutableArray alloc] init];
+	_slotsByFingerprint = [[NSMutableDictionary alloc] init];
+
+	return self;
+}
+
+- (void)dealloc {
+	[self freeBuckets];
+	[_keys release];
+	[_texts release];
+	[_slotsByFingerprint release];
+	[super dealloc];
+}
+
+
+#pragma mark Hash table
+
+- (void)freeBuckets {
+	GPGTrigramPosting *buckets = _buckets;
+	for (NSUInteger i = 0; i < _bucketCount; i++) {
+		free(buckets[i].slots);
+	}
+	free(_buckets);
+	_buckets = NULL;
+	_bucketCount = 0;
+	_usedBucketCount = 0;
+}
+
+- (GPGTrigramPosting *)postingForTrigram:(uint32_t)trigram create:(BOOL)create {
+	if (_bucketCount == 0) {
+		if (!create) {
+			return NULL;
+		}
+		_bucketCount = 4096;
+		_buckets = calloc(_bucketCount, sizeof(GPGTrigramPosting));
+	} else if (create && _usedBucketCount * 2 >= _bucketCount) {
+		[self growBuckets];
+	}
+
+	GPGTrigramPosting *buckets = _buckets;
+	NSUInteger index = bucketIndex(trigram, _bucketCount);
+	while (buckets[index].trigram != 0) {
+		if (buckets[index].trigram == trigram) {
+			return &buckets[index];
+		}
+		index = (index + 1) & (_bucketCount - 1);
+	}
+
+	if (!create) {
+		return NULL;
+	}
+	buckets[index].trigram = trigram;
+	_usedBucketCount++;
+	return &buckets[index];
+}
+
+- (void)growBuckets {
+	GPGTrigramPosting *oldBuckets = _buckets;
+	NSUInteger oldCount = _bucketCount;
+
+	_bucketCount = oldCount * 2;
+	GPGTrigramPosting *buckets = calloc(_bucketCount, sizeof(GPGTrigramPosting));
+	_buckets = buckets;
+
+	for (NSUInteger i = 0; i < oldCount; i++) {
+		if (oldBuckets[i].trigram == 0) {
+			continue;
+		}
+		NSUInteger index = bucketIndex(oldBuckets[i].trigram, _bucketCount);
+		while (buckets[index].trigram != 0) {
+			index = (index + 1) & (_bucketCount - 1);
+		}
+		buckets[index] = oldBuckets[i];
+	}
+	free(oldBuckets);
+}
+
+- (void)indexText:(NSData *)text slot:(uint32_t)slot {
+	const uint8_t *bytes = text.bytes;
+	NSUInteger length = text.length;
+
+	for (NSUInteger i = 0; i + 3 <= length; i++) {
+		GPGTrigramPosting *posting = [self postingForTrigram:TRIGRAM(bytes + i) create:YES];
+
+		// Slots are added in ascending order, so a repeated trigram of the same text is always the last entry.
+		if (posting->count > 0 && posting->slots[posting->count - 1] == slot) {
+			continue;
+		}
+		if (posting->count == posting->capacity) {
+			posting->capacity = posting->capacity ? posting->capacity * 2 : 4;
+			posting->slots = reallocf(posting->slots, posting->capacity * sizeof(uint32_t));
+			if (!posting->slots) {
+				[NSException raise:NSMallocException format:@"Out of memory"];
+			}
+		}
+		posting->slots[posting->count++] = slot;
+	}
+}
+
+
+#pragma mark Keys
+
+- (void)addKey:(GPGKey *)key {
+	NSString *fingerprint = key.fingerprint;
+	if (!fingerprint) {
+		return;
+	}
+	NSData *text = foldedText(key.textForFilter);
+
+	@synchronized (self) {
+		[self removeKeyWithFingerprint:fingerprint];
+
+		uint32_t slot = (uint32_t)_keys.count;
+		[_keys addObject:key];
+		[_texts addObject:text];
+		[_slotsByFingerprint setObject:@(slot) forKey:fingerprint];
+
+		[self indexText:text slot:slot];
+	}
+}
+
+- (void)removeKeyWithFingerprint:(NSString *)fingerprint {
+	@synchronized (self) {
+		NSNumber *slot = [_slotsByFingerprint objectForKey:fingerprint];
+		if (!slot) {
+			return;
+		}
+		[_slotsByFingerprint removeObjectForKey:fingerprint];
+		[_keys replaceObjectAtIndex:slot.unsignedIntegerValue withObject:[NSNull null]];
+		[_texts replaceObjectAtIndex:slot.unsignedIntegerValue withObject:[NSData data]];
+		_removedCount++;
+
+		if (_removedCount >= MIN_REMOVED_FOR_REBUILD && _removedCount > _slotsByFingerprint.count) {
+			[self rebuild];
+		}
+	}
+}
+
+- (void)removeAllKeys {
+	@synchronized (self) {
+		[self freeBuckets];
+		[_keys removeAllObjects];
+		[_texts removeAllObjects];
+		[_slotsByFingerprint removeAllObjects];
+		_removedCount = 0;
+	}
+}
+
+// Drops the gaps of removed keys. The folded texts are kept, so nothing has to be folded again.
+- (void)rebuild {
+	NSArray *keys = [_keys autorelease];
+	NSArray *texts = [_texts autorelease];
+	NSNull *null = [NSNull null];
+
+	[self freeBuckets];
+	_keys = [[NSMutableArray alloc] initWithCapacity:_slotsByFingerprint.count];
+	_texts = [[NSMutableArray alloc] initWithCapacity:_slotsByFingerprint.count];
+	[_slotsByFingerprint removeAllObjects];
+	_removedCount = 0;
+
+	NSUInteger count = keys.count;
+	for (NSUInteger i = 0; i < count; i++) {
+		GPGKey *key = [keys objectAtIndex:i];
+		if (key == (id)null) {
+			continue;
+		}
+		NSData *text = [texts objectAtIndex:i];
+		uint32_t slot = (uint32_t)_keys.count;
+		[_keys addObject:key];
+		[_texts addObject:text];
+		[_slotsByFingerprint setObject:@(slot) forKey:key.fingerprint];
+		[self indexText:text slot:slot];
+	}
+}
+
+
+#pragma mark Search
+
+static int comparePostingCounts(const void *a, const void *b) {
+	uint32_t countA = (*(GPGTrigramPosting * const *)a)->count;
+	uint32_t countB = (*(GPGTrigramPosting * const *)b)->count;
+	return countA < countB ? -1 : countA > countB;
+}
+
+// Keeps the entries of candidates, which are also in posting. Both are sorted. Returns the new count.
+static NSUInteger intersect(uint32_t *candidates, NSUInteger count, const GPGTrigramPosting *posting) {
+	NSUInteger kept = 0;
+	NSUInteger j = 0;
+	for (NSUInteger i = 0; i < count; i++) {
+		uint32_t slot = candidates[i];
+		while (j < posting->count && posting->slots[j] < slot) {
+			j++;
+		}
+		if (j == posting->count) {
+			break;
+		}
+		if (posting->slots[j] == slot) {
+			candidates[kept++] = slot;
+		}
+	}
+	return kept;
+}
+
+- (NSSet *)keysMatchingSearchString:(NSString *)searchString {
+	NSData *query = foldedText(searchString);
+	const uint8_t *queryBytes = query.bytes;
+	NSUInteger queryLength = query.length;
+	NSMutableSet *result = [NSMutableSet set];
+	NSNull *null = [NSNull null];
+
+	@synchronized (self) {
+		if (queryLength < 3) {
+			// Too short for a trigram. Such a query matches most keys anyway.
+			NSUInteger count = _keys.count;
+			for (NSUInteger i = 0; i < count; i++) {
+				GPGKey *key = [_keys objectAtIndex:i];
+				NSData *text = [_texts objectAtIndex:i];
+				if (key != (id)null && (queryLength == 0 || lm_memmem(text.bytes, text.length, queryBytes, queryLength))) {
+					[result addObject:key];
+				}
+			}
+			return result;
+		}
+
+		NSUInteger trigramCount = queryLength - 2;
+		GPGTrigramPosting **postings = malloc(trigramCount * sizeof(GPGTrigramPosting *));
+		if (!postings) {
+			return result;
+		}
+		for (NSUInteger i = 0; i < trigramCount; i++) {
+			postings[i] = [self postingForTrigram:TRIGRAM(queryBytes + i) create:NO];
+			if (!postings[i]) {
+				// A trigram no key contains.
+				free(postings);
+				return result;
+			}
+		}
+		qsort(postings, trigramCount, sizeof(GPGTrigramPosting *), comparePostingCounts);
+
+		NSUInteger count = postings[0]->count;
+		uint32_t *candidates = malloc(count * sizeof(uint32_t));
+		if (!candidates) {
+			free(postings);
+			return result;
+		}
+		memcpy(candidates, postings[0]->slots, count * sizeof(uint32_t));
+		for (NSUInteger i = 1; i < trigramCount && count > 0; i++) {
+			if (postings[i] != postings[i - 1]) {
+				count = intersect(candidates, count, postings[i]);
+			}
+		}
+		free(postings);
+
+		// All trigrams match, but maybe not in the right order.
+		for (NSUInteger i = 0; i < count; i++) {
+			GPGKey *key = [_keys objectAtIndex:candidates[i]];
+			if (key == (id)null) {
+				continue;
+			}
+			NSData *text = [_texts objectAtIndex:candidates[i]];
+			if (queryLength == 3 || lm_memmem(text.bytes, text.length, queryBytes, queryLength)) {
+				[result addObject:key];
+			}
+		}
+		free(candidates);
+	}
+
+	return result;
+}
+
+@end
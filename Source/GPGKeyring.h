@@ -0,0 +1,62 @@
+//
+//  GPGKeyring.h
+//  Libmacgpg
+//
+
+#import <Foundation/Foundation.h>
+
+@class GPGKey;
+
+/*
+ * An immutable state of the keyring: the loaded keys and all indexes over them.
+ *
+ * GPGKeyManager creates a new GPGKeyring whenever a load changed the keys and replaces the old one
+ * in a single step. So the keys and indexes of one GPGKeyring always belong together, even if keys
+ * are loaded on another thread while it is used.
+ *
+ * generation increases with every new GPGKeyring. If the generation of GPGKeyManager's keyring
+ * equals a remembered one, nothing has changed since.
+ *
+ * keyringStamp is the state of the keyring files, when the keys were listed by gpg. If the files
+ * have the same state now, the keys are up to date.
+ */
+@interface GPGKeyring : NSObject {
+	NSUInteger _generation;
+	NSData *_keyringStamp;
+	NSSet *_allKeys;
+	NSSet *_secretKeys;
+	NSDictionary *_keysByKeyID;
+	NSDictionary *_keysByFingerprint;
+	NSDictionary *_keysByKeygrip;
+	NSDictionary *_keysByEmail;
+	NSDictionary *_keysByUserIDHash;
+
+	NSSet *_allKeysAndSubkeys; // Created when first used.
+	dispatch_once_t _allKeysAndSubkeysOnce;
+}
+
+/* Builds all indexes of keys, a set of primary GPGKeys. */
+- (instancetype)initWithKeys:(NSSet *)keys generation:(NSUInteger)generation keyringStamp:(NSData *)keyringStamp;
+- (instancetype)initWithKeys:(NSSet *)keys generation:(NSUInteger)generation;
+
+@property (nonatomic, readonly) NSUInteger generation;
+/* nil if it's unknown, whether the keys match the keyring files, e.g. after a load from the snapshot. */
+@property (nonatomic, readonly) NSData *keyringStamp;
+
+@property (nonatomic, readonly) NSSet *allKeys;
+@property (nonatomic, readonly) NSSet *allKeysAndSubkeys;
+@property (nonatomic, readonly) NSSet *secretKeys;
+
+/* keysByKeyID, keysByFingerprint and keysByKeygrip map to the key or subkey itself.
+ * keysByEmail (lowercase email) and keysByUserIDHash map to an NSArray of primary keys.
+ */
+@property (nonatomic, readonly) NSDictionary *keysByKeyID;
+@property (nonatomic, readonly) NSDictionary *keysByFingerprint;
+@property (nonatomic, readonly) NSDictionary *keysByKeygrip;
+@property (nonatomic, readonly) NSDictionary *keysByEmail;
+@property (nonatomic, readonly) NSDictionary *keysByUserIDHash;
+
+/* The normalized form of email, as used by keysByEmail. nil for an empty email. */
++ (NSString *)normalizedEmail:(NSString *)email;
+
+@end
@@ -0,0 +1,132 @@
+//
+//  GPGKeyring.m
+//  Libmacgpg
+//
+
+#import "GPGKeyring.h"
+#import "GPGKey.h"
+#import "GPGUserID.h"
+
+
+// Adds key to the array for indexKey in index. A key is only added once, even if it has multiple matching user IDs.
+static void addKeyToIndex(NSMutableDictionary *index, NSString *indexKey, GPGKey *key) {
+	if (indexKey.length == 0) {
+		return;
+	}
+	NSMutableArray *keys = [index objectForKey:indexKey];
+	if (!keys) {
+		keys = [[NSMutableArray alloc] initWithObjects:key, nil];
+		[index setObject:keys forKey:indexKey];
+		[keys release];
+	} else if (keys.lastObject != key) {
+		[keys addObject:key];
+	}
+}
+
+static void addKeyToFingerprintIndexes(GPGKey *key, NSMutableDictionary *keysByFingerprint, NSMutableDictionary *keysByKeygrip) {
+	if (key.fingerprint) {
+		[keysByFingerprint setObject:key forKey:key.fingerprint];
+	}
+	if (key.keygrip) {
+		[keysByKeygrip setObject:key forKey:key.keygrip];
+	}
+}
+
+
+@implementation GPGKeyring
+
+@synthesize generation=_generation, keyringStamp=_keyringStamp, allKeys=_allKeys, secretKeys=_secretKeys,
+			keysByKeyID=_keysByKeyID, keysByFingerprint=_keysByFingerprint,
+			keysByKeygrip=_keysByKeygrip, keysByEmail=_keysByEmail,
+			keysByUserIDHash=_keysByUserIDHash;
+
++ (NSString *)normalizedEmail:(NSString *)email {
+	email = [email stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+	if (email.length == 0) {
+		return nil;
+	}
+	return email.lowercaseString;
+}
+
+- (instancetype)initWithKeys:(NSSet *)keys generation:(NSUInteger)generation keyringStamp:(NSData *)keyringStamp {
+	self = [super init];
+	if (!self) {
+		return nil;
+	}
+
+	_generation = generation;
+	_keyringStamp = [keyringStamp copy];
+	_allKeys = keys ? [keys copy] : [[NSSet alloc] init];
+
+	NSUInteger count = _allKeys.count;
+	NSMutableDictionary *keysByKeyID = [[NSMutableDictionary alloc] initWithCapacity:count * 2];
+	NSMutableDictionary *keysByFingerprint = [[NSMutableDictionary alloc] initWithCapacity:count * 2];
+	NSMutableDictionary *keysByKeygrip = [[NSMutableDictionary alloc] initWithCapacity:count * 2];
+	NSMutableDictionary *keysByEmail = [[NSMutableDictionary alloc] initWithCapacity:count];
+	NSMutableDictionary *keysByUserIDHash = [[NSMutableDictionary alloc] initWithCapacity:count];
+	NSMutableSet *secretKeys = [[NSMutableSet alloc] init];
+
+	for (GPGKey *key in _allKeys) {
+		if (key.secret) {
+			[secretKeys addObject:key];
+		}
+		[keysByKeyID setObject:key forKey:key.keyID];
+		addKeyToFingerprintIndexes(key, keysByFingerprint, keysByKeygrip);
+		for (GPGKey *subkey in key.subkeys) {
+			[keysByKeyID setObject:subkey forKey:subkey.keyID];
+			addKeyToFingerprintIndexes(subkey, keysByFingerprint, keysByKeygrip);
+		}
+		for (GPGUserID *userID in key.userIDs) {
+			addKeyToIndex(keysByEmail, [GPGKeyring normalizedEmail:userID.email], key);
+			addKeyToIndex(keysByUserIDHash, userID.hashID, key);
+		}
+	}
+
+	// The mutable collections are never handed out, so they don't have to be copied.
+	_keysByKeyID = keysByKeyID;
+	_keysByFingerprint = keysByFingerprint;
+	_keysByKeygrip = keysByKeygrip;
+	_keysByEmail = keysByEmail;
+	_keysByUserIDHash = keysByUserIDHash;
+	_secretKeys = secretKeys;
+
+	return self;
+}
+
+- (instancetype)initWithKeys:(NSSet *)keys generation:(NSUInteger)generation {
+	return [self initWithKeys:keys generation:generation keyringStamp:nil];
+}
+
+- (instancetype)init {
+	return [self initWithKeys:nil generation:0 keyringStamp:nil];
+}
+
+- (void)dealloc {
+	[_keyringStamp release];
+	[_allKeys release];
+	[_secretKeys release];
+	[_keysByKeyID release];
+	[_keysByFingerprint release];
+	[_keysByKeygrip release];
+	[_keysByEmail release];
+	[_keysByUserIDHash release];
+	[_allKeysAndSubkeys release];
+	[super dealloc];
+}
+
+- (NSSet *)allKeysAndSubkeys {
+	dispatch_once(&_allKeysAndSubkeysOnce, ^{
+		NSMutableSet *allKeysAndSubkeys = [[NSMutableSet alloc] initWithSet:_allKeys copyItems:NO];
+		for (GPGKey *key in _allKeys) {
+			[allKeysAndSubkeys addObjectsFromArray:key.subkeys];
+		}
+		_allKeysAndSubkeys = allKeysAndSubkeys;
+	});
+	return _allKeysAndSubkeys;
+}
+
+- (NSString *)description {
+	return [NSString stringWithFormat:@"<%@: %p> generation %lu, %lu keys", [self class], self, (unsigned long)_generation, (unsigned long)_allKeys.count];
+}
+
+@end
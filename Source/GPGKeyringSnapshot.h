@@ -0,0 +1,45 @@
+//
+//  GPGKeyringSnapshot.h
+//  Libmacgpg
+//
+
+#import <Foundation/Foundation.h>
+
+/*
+ * A copy of gpg's colon listings of all keys, stored in the gpg home directory.
+ *
+ * GPGKeyManager uses it to have allKeys available at startup without running gpg.
+ * The snapshot contains the output of "--list-secret-keys" and "--list-keys", so it's parsed
+ * the same way as the output of gpg and contains the same keys, subkeys, user IDs and secret flags.
+ *
+ * The snapshot is only valid, if the keyring files are unchanged since the listings were made.
+ * This is checked by device, inode, size and modification time of the files.
+ */
+@interface GPGKeyringSnapshot : NSObject {
+	NSData *_data;
+	NSData *_secretListing;
+	NSData *_publicListing;
+}
+
+/*
+ * Returns the snapshot stored in homedir, or nil if there is none or the keyring changed since it was written.
+ * The file is mapped into memory, not read.
+ */
++ (instancetype)snapshotForHomedir:(NSString *)homedir;
+
+/*
+ * The state of the keyring files in homedir. Must be taken before the listings are made, so
+ * a change while gpg runs invalidates the snapshot.
+ */
++ (NSData *)keyringStampForHomedir:(NSString *)homedir;
+
+/*
+ * Writes a new snapshot atomically. Errors are ignored, the snapshot is only a cache.
+ */
++ (void)writeSnapshotWithSecretListing:(NSData *)secretListing publicListing:(NSData *)publicListing keyringStamp:(NSData *)stamp homedir:(NSString *)homedir;
+
+// The listings. They point into the mapped file and are only valid while the snapshot exists.
+@property (nonatomic, readonly) NSData *secretListing;
+@property (nonatomic, readonly) NSData *publicListing;
+
+@end
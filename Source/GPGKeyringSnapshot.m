@@ -0,0 +1,143 @@
+//
+//  GPGKeyringSnapshot.m
+//  Libmacgpg
+//
+
+#import "GPGKeyringSnapshot.h"
+#import "GPGGlobals.h"
+#import <sys/stat.h>
+
+#define SNAPSHOT_FILE_NAME @"libmacgpg-keyring.cache"
+#define SNAPSHOT_MAGIC "GPGKSNAP"
+// Increase when the file format or the gpg arguments used for the listings change.
+#define SNAPSHOT_VERSION 2
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t stampLength;
+	uint64_t secretLength;
+	uint64_t publicLength;
+} GPGKeyringSnapshotHeader;
+
+typedef struct {
+	uint64_t device;
+	uint64_t inode;
+	uint64_t size;
+	int64_t modificationSeconds;
+	int64_t modificationNanoseconds;
+} GPGKeyringFileStamp;
+
+
+@implementation GPGKeyringSnapshot
+@synthesize secretListing = _secretListing, publicListing = _publicListing;
+
+// Every file which influences the listings. private-keys-v1.d is a directory, its modification time changes
+// when a secret key is added or removed.
++ (NSArray *)keyringFileNames {
+	return @[@"pubring.kbx", @"pubring.gpg", @"trustdb.gpg", @"secring.gpg", @"private-keys-v1.d"];
+}
+
++ (NSData *)keyringStampForHomedir:(NSString *)homedir {
+	NSArray *fileNames = [self keyringFileNames];
+	NSMutableData *stamp = [NSMutableData dataWithLength:fileNames.count * sizeof(GPGKeyringFileStamp)];
+	GPGKeyringFileStamp *fileStamps = stamp.mutableBytes;
+
+	NSUInteger i = 0;
+	for (NSString *fileName in fileNames) {
+		struct stat info;
+		// A missing file keeps an all-zero stamp, so its creation invalidates the snapshot too.
+		if (stat([homedir stringByAppendingPathComponent:fileName].fileSystemRepresentation, &info) == 0) {
+			fileStamps[i].device = info.st_dev;
+			fileStamps[i].inode = info.st_ino;
+			fileStamps[i].size = info.st_size;
+			fileStamps[i].modificationSeconds = info.st_mtimespec.tv_sec;
+			fileStamps[i].modificationNanoseconds = info.st_mtimespec.tv_nsec;
+		}
+		i++;
+	}
+
+	return stamp;
+}
+
++ (instancetype)snapshotForHomedir:(NSString *)homedir {
+	NSString *path = [homedir stringByAppendingPathComponent:SNAPSHOT_FILE_NAME];
+	NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedAlways error:nil];
+	if (data.length < sizeof(GPGKeyringSnapshotHeader)) {
+		return nil;
+	}
+
+	GPGKeyringSnapshotHeader header;
+	memcpy(&header, data.bytes, sizeof(header));
+	if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.version != SNAPSHOT_VERSION) {
+		return nil;
+	}
+	if (sizeof(header) + (uint64_t)header.stampLength + header.secretLength + header.publicLength != data.length) {
+		GPGDebugLog(@"Keyring snapshot is truncated.");
+		return nil;
+	}
+
+	const uint8_t *bytes = (const uint8_t *)data.bytes + sizeof(header);
+	NSData *currentStamp = [self keyringStampForHomedir:homedir];
+	if (currentStamp.length != header.stampLength || memcmp(currentStamp.bytes, bytes, header.stampLength) != 0) {
+		return nil;
+	}
+	bytes += header.stampLength;
+
+	GPGKeyringSnapshot *snapshot = [[[self alloc] init] autorelease];
+	snapshot->_data = [data retain];
+	snapshot->_secretListing = [[NSData alloc] initWithBytesNoCopy:(void *)bytes length:(NSUInteger)header.secretLength freeWhenDone:NO];
+	bytes += header.secretLength;
+	snapshot->_publicListing = [[NSData alloc] initWithBytesNoCopy:(void *)bytes length:(NSUInteger)header.publicLength freeWhenDone:NO];
+
+	return snapshot;
+}
+
++ (void)writeSnapshotWithSecretListing:(NSData *)secretListing publicListing:(NSData *)publicListing keyringStamp:(NSData *)stamp homedir:(NSString *)homedir {
+	GPGKeyringSnapshotHeader header = {{0}};
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.stampLength = (uint32_t)stamp.length;
+	header.secretLength = secretListing.length;
+	header.publicLength = publicListing.length;
+
+	NSString *path = [homedir stringByAppendingPathComponent:SNAPSHOT_FILE_NAME];
+	char tempPath[PATH_MAX];
+	if (snprintf(tempPath, sizeof(tempPath), "%s.XXXXXX", path.fileSystemRepresentation) >= (int)sizeof(tempPath)) {
+		return;
+	}
+
+	// mkstemp creates the file with mode 0600. The listings shouldn't be readable by other users.
+	int fd = mkstemp(tempPath);
+	if (fd < 0) {
+		GPGDebugLog(@"Unable to write keyring snapshot: %s", strerror(errno));
+		return;
+	}
+
+	NSFileHandle *fileHandle = [[NSFileHandle alloc] initWithFileDescriptor:fd closeOnDealloc:YES];
+	BOOL success = NO;
+	@try {
+		[fileHandle writeData:[NSData dataWithBytes:&header length:sizeof(header)]];
+		[fileHandle writeData:stamp];
+		[fileHandle writeData:secretListing];
+		[fileHandle writeData:publicListing];
+		success = YES;
+	}
+	@catch (NSException *exception) {
+		GPGDebugLog(@"Unable to write keyring snapshot: %@", exception);
+	}
+	[fileHandle release];
+
+	if (!success || rename(tempPath, path.fileSystemRepresentation) != 0) {
+		unlink(tempPath);
+	}
+}
+
+- (void)dealloc {
+	[_secretListing release];
+	[_publicListing release];
+	[_data release];
+	[super dealloc];
+}
+
+@end
@@ -0,0 +1,69 @@
+//
+//  GPGProcess.h
+//  Libmacgpg
+//
+
+#import <Foundation/Foundation.h>
+
+@class GPGTaskLaunchContext;
+
+/*
+ * GPGProcess launches a process using posix_spawn and replaces NSTask
+ * in GPGTaskHelper.
+ *
+ * stdin, stdout and stderr of the child are connected to pipes.
+ * additionalOutputs creates further pipes, which are available to the
+ * child as fd 3, 4, ... (e.g. for --status-fd and --attribute-fd).
+ * Every other descriptor of this process is closed in the child.
+ *
+ * All pipes are serviced by dispatch_io and all processes are reaped on
+ * one shared queue. No thread is blocked while a process is running, the
+ * handlers are only called when there is something to do.
+ */
+@interface GPGProcess : NSObject {
+	pid_t _processIdentifier;
+	int _terminationStatus;
+	BOOL _running;
+	dispatch_source_t _exitSource;
+	dispatch_group_t _exitGroup;
+	dispatch_io_t *_channels;
+	int _channelCount;
+}
+
+@property (nonatomic, readonly) pid_t processIdentifier;
+@property (nonatomic, readonly, getter=isRunning) BOOL running;
+/* The exit code, or the signal number if the process was terminated by a signal. */
+@property (nonatomic, readonly) int terminationStatus;
+
+
+/*
+ * Launches the executable at path.
+ * The environment of context is used, extended by environmentVariables.
+ * Raises an exception if the process couldn't be launched.
+ */
++ (GPGProcess *)launchedProcessWithPath:(NSString *)path arguments:(NSArray *)arguments context:(GPGTaskLaunchContext *)context environmentVariables:(NSDictionary *)environmentVariables additionalOutputs:(NSUInteger)additionalOutputs;
+
+/*
+ * Reads the child's fd (1 = stdout, 2 = stderr, 3... = additional outputs) until EOF.
+ * handler is called on queue for every chunk of data, as soon as it's available.
+ * The last call has done set to YES, data may be nil then.
+ */
+- (void)readFileDescriptor:(int)fd queue:(dispatch_queue_t)queue handler:(void (^)(NSData *data, BOOL done))handler;
+
+/*
+ * Writes data to the child's stdin. Writes are performed in the order they were submitted.
+ * completion is called on queue, error is 0 on success.
+ */
+- (void)writeToStandardInput:(NSData *)data queue:(dispatch_queue_t)queue completion:(void (^)(int error))completion;
+
+/* Closes stdin after all pending writes are done. */
+- (void)closeStandardInput;
+/* Closes all pipes immediately. Pending reads and writes are cancelled. */
+- (void)closePipes;
+
+/* Blocks until the process exited. */
+- (void)waitUntilExit;
+/* Sends SIGTERM to the process, if it's still running. */
+- (void)terminate;
+
+@end
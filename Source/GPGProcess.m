@@ -0,0 +1,334 @@
+//
+//  GPGProcess.m
+//  Libmacgpg
+//
+
+#import "GPGProcess.h"
+#import "GPGTaskLaunchContext.h"
+#import "GPGGlobals.h"
+#include <spawn.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#ifndef F_SETNOSIGPIPE
+#define F_SETNOSIGPIPE		73	/* No SIGPIPE generated on EPIPE */
+#endif
+
+
+@interface GPGProcess ()
+- (void)launchWithPath:(NSString *)path arguments:(NSArray *)arguments context:(GPGTaskLaunchContext *)context environmentVariables:(NSDictionary *)environmentVariables additionalOutputs:(NSUInteger)additionalOutputs;
+- (void)reap;
+@end
+
+
+@implementation GPGProcess
+@synthesize processIdentifier=_processIdentifier, terminationStatus=_terminationStatus;
+
+
+/* All processes are reaped on this queue. _running is only modified on it. */
+static dispatch_queue_t reaperQueue(void) {
+	static dispatch_queue_t queue = nil;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		queue = dispatch_queue_create("org.gpgtools.libmacgpg.processReaper", NULL);
+	});
+	return queue;
+}
+
+/* The spawn attributes are the same for every process, so they are only built once. */
+static const posix_spawnattr_t *spawnAttributes(void) {
+	static posix_spawnattr_t attributes;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		posix_spawnattr_init(&attributes);
+
+		// Don't inherit our signal mask and ignored signals. Especially SIGPIPE is ignored by many apps.
+		sigset_t signals;
+		sigemptyset(&signals);
+		posix_spawnattr_setsigmask(&attributes, &signals);
+		sigfillset(&signals);
+		posix_spawnattr_setsigdefault(&attributes, &signals);
+
+		short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_CLOEXEC_DEFAULT
+		// Only the descriptors set up by the file actions are inherited.
+		flags |= POSIX_SPAWN_CLOEXEC_DEFAULT;
+#endif
+		posix_spawnattr_setflags(&attributes, flags);
+	});
+	return &attributes;
+}
+
+static void setCloseOnExec(int fd) {
+	fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+}
+
+/*
+ * Makes sure fd isn't lower than minFd.
+ * Otherwise a dup2 in the child could overwrite a descriptor, which is still needed.
+ */
+static int moveDescriptorAbove(int fd, int minFd) {
+	if (fd >= minFd) {
+		return fd;
+	}
+	int newFd = fcntl(fd, F_DUPFD, minFd);
+	close(fd);
+	if (newFd >= 0) {
+		setCloseOnExec(newFd);
+	}
+	return newFd;
+}
+
+
++ (GPGProcess *)launchedProcessWithPath:(NSString *)path arguments:(NSArray *)arguments context:(GPGTaskLaunchContext *)context environmentVariables:(NSDictionary *)environmentVariables additionalOutputs:(NSUInteger)additionalOutputs {
+	GPGProcess *process = [[[self alloc] init] autorelease];
+	[process launchWithPath:path arguments:arguments context:context environmentVariables:environmentVariables additionalOutputs:additionalOutputs];
+	return process;
+}
+
+- (void)launchWithPath:(NSString *)path arguments:(NSArray *)arguments context:(GPGTaskLaunchContext *)context environmentVariables:(NSDictionary *)environmentVariables additionalOutputs:(NSUInteger)additionalOutputs {
+	// Everything is allocated before the process is spawned, so running out of memory can't leave a child behind.
+	NSUInteger argumentCount = arguments.count;
+	NSDictionary *environment = environmentVariables.count > 0 ? [context environmentWithVariables:environmentVariables] : nil;
+	int pipeCount = 3 + (int)additionalOutputs;
+
+	const char **argv = malloc((argumentCount + 2) * sizeof(char *));
+	const char **customEnvp = environment ? malloc((environment.count + 1) * sizeof(char *)) : NULL;
+	int *parentFds = malloc(pipeCount * sizeof(int));
+	int *childFds = malloc(pipeCount * sizeof(int));
+	dispatch_io_t *channels = malloc(pipeCount * sizeof(dispatch_io_t));
+	if (!argv || (environment && !customEnvp) || !parentFds || !childFds || !channels) {
+		free(argv);
+		free(customEnvp);
+		free(parentFds);
+		free(childFds);
+		free(channels);
+		[NSException raise:NSMallocException format:@"Out of memory"];
+	}
+
+	// argv and envp. The UTF-8 strings are owned by the autorelease pool.
+	argv[0] = path.fileSystemRepresentation;
+	for (NSUInteger i = 0; i < argumentCount; i++) {
+		// gpg wants utf-8 encoded umlauts, so don't use the fileSystemRepresentation here.
+		argv[i + 1] = [arguments[i] UTF8String];
+	}
+	argv[argumentCount + 1] = NULL;
+
+	char * const *envp = context.envp;
+	if (environment) {
+		NSUInteger i = 0;
+		for (NSString *key in environment) {
+			customEnvp[i++] = [NSString stringWithFormat:@"%@=%@", key, environment[key]].UTF8String;
+		}
+		customEnvp[i] = NULL;
+		envp = (char * const *)customEnvp;
+	}
+
+
+	// Create the pipes. Pipe i is the child's fd i.
+	int pipeError = 0;
+	int createdPipes = 0;
+
+	for (; createdPipes < pipeCount; createdPipes++) {
+		int fds[2];
+		if (pipe(fds) != 0) {
+			pipeError = errno;
+			break;
+		}
+		setCloseOnExec(fds[0]);
+		setCloseOnExec(fds[1]);
+
+		if (createdPipes == 0) {
+			// stdin: The child reads, we write.
+			childFds[createdPipes] = fds[0];
+			parentFds[createdPipes] = fds[1];
+		} else {
+			childFds[createdPipes] = fds[1];
+			parentFds[createdPipes] = fds[0];
+		}
+		childFds[createdPipes] = moveDescriptorAbove(childFds[createdPipes], pipeCount);
+		if (childFds[createdPipes] < 0) {
+			pipeError = errno;
+			close(parentFds[createdPipes]);
+			break;
+		}
+	}
+
+
+	pid_t pid = 0;
+	int spawnError = pipeError;
+	if (!pipeError) {
+		posix_spawn_file_actions_t fileActions;
+		posix_spawn_file_actions_init(&fileActions);
+		for (int i = 0; i < pipeCount; i++) {
+			posix_spawn_file_actions_adddup2(&fileActions, childFds[i], i);
+		}
+
+		GPGDebugLog(@"$> %@ %@", path, [arguments componentsJoinedByString:@" "]);
+		spawnError = posix_spawn(&pid, argv[0], &fileActions, spawnAttributes(), (char * const *)argv, envp);
+
+		posix_spawn_file_actions_destroy(&fileActions);
+	}
+
+	free(argv);
+	free(customEnvp);
+
+	// The child has its own copy of these.
+	for (int i = 0; i < createdPipes; i++) {
+		close(childFds[i]);
+	}
+	free(childFds);
+
+	if (spawnError) {
+		for (int i = 0; i < createdPipes; i++) {
+			close(parentFds[i]);
+		}
+		free(parentFds);
+		free(channels);
+		[NSException raise:NSGenericException format:@"%@ failed: %s", pipeError ? @"pipe" : @"posix_spawn", strerror(spawnError)];
+	}
+
+
+	// Writing to stdin of a terminated gpg must not kill us.
+	fcntl(parentFds[0], F_SETNOSIGPIPE, 1);
+
+	// Every pipe is serviced by a dispatch_io channel, which owns the descriptor.
+	_channelCount = pipeCount;
+	_channels = channels;
+	for (int i = 0; i < pipeCount; i++) {
+		int fd = parentFds[i];
+		_channels[i] = dispatch_io_create(DISPATCH_IO_STREAM, fd, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(int error) {
+			close(fd);
+		});
+		if (i > 0) {
+			// Deliver data as soon as something was read.
+			dispatch_io_set_low_water(_channels[i], 1);
+		}
+	}
+	free(parentFds);
+
+
+	// Reap the process as soon as it exits. The event handler retains self until then.
+	_processIdentifier = pid;
+	_running = YES;
+	_exitGroup = dispatch_group_create();
+	dispatch_group_enter(_exitGroup);
+
+	// If the process already exited, the source fires immediately.
+	_exitSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_PROC, pid, DISPATCH_PROC_EXIT, reaperQueue());
+	dispatch_source_set_event_handler(_exitSource, ^{
+		[self reap];
+	});
+	dispatch_resume(_exitSource);
+}
+
+- (void)reap {
+	int status = 0;
+	pid_t result;
+	do {
+		result = waitpid(_processIdentifier, &status, 0);
+	} while (result == -1 && errno == EINTR);
+
+	if (result == _processIdentifier) {
+		if (WIFEXITED(status)) {
+			_terminationStatus = WEXITSTATUS(status);
+		} else if (WIFSIGNALED(status)) {
+			_terminationStatus = WTERMSIG(status);
+		}
+	}
+	_running = NO;
+
+	dispatch_source_cancel(_exitSource);
+	dispatch_release(_exitSource);
+	_exitSource = nil;
+
+	dispatch_group_leave(_exitGroup);
+}
+
+- (BOOL)isRunning {
+	__block BOOL running = NO;
+	dispatch_sync(reaperQueue(), ^{
+		running = _running;
+	});
+	return running;
+}
+
+- (void)readFileDescriptor:(int)fd queue:(dispatch_queue_t)queue handler:(void (^)(NSData *data, BOOL done))handler {
+	if (fd < 1 || fd >= _channelCount) {
+		[NSException raise:NSInvalidArgumentException format:@"Invalid file descriptor %i", fd];
+	}
+	handler = [[handler copy] autorelease];
+
+	dispatch_io_read(_channels[fd], 0, SIZE_MAX, queue, ^(bool done, dispatch_data_t data, int error) {
+		NSMutableData *readData = nil;
+		size_t size = data ? dispatch_data_get_size(data) : 0;
+		if (size > 0) {
+			readData = [NSMutableData dataWithCapacity:size];
+			dispatch_data_apply(data, ^bool(dispatch_data_t region, size_t offset, const void *buffer, size_t regionSize) {
+				[readData appendBytes:buffer length:regionSize];
+				return true;
+			});
+		}
+		if (readData || done) {
+			handler(readData, done);
+		}
+	});
+}
+
+- (void)writeToStandardInput:(NSData *)data queue:(dispatch_queue_t)queue completion:(void (^)(int error))completion {
+	completion = [[completion copy] autorelease];
+
+	dispatch_data_t dispatchData = dispatch_data_create(data.bytes, data.length, queue, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+	dispatch_io_write(_channels[0], 0, dispatchData, queue, ^(bool done, dispatch_data_t remaining, int error) {
+		if (done && completion) {
+			completion(error);
+		}
+	});
+	dispatch_release(dispatchData);
+}
+
+- (void)closeStandardInput {
+	dispatch_io_close(_channels[0], 0);
+}
+
+- (void)closePipes {
+	for (int i = 0; i < _channelCount; i++) {
+		dispatch_io_close(_channels[i], DISPATCH_IO_STOP);
+	}
+}
+
+- (void)waitUntilExit {
+	if (_exitGroup) {
+		dispatch_group_wait(_exitGroup, DISPATCH_TIME_FOREVER);
+	}
+}
+
+- (void)terminate {
+	// Check and kill on the reaper queue, so the pid can't be reaped (and reused) in between.
+	dispatch_sync(reaperQueue(), ^{
+		if (_running) {
+			kill(_processIdentifier, SIGTERM);
+		}
+	});
+}
+
+- (void)dealloc {
+	if (_channels) {
+		for (int i = 0; i < _channelCount; i++) {
+			dispatch_io_close(_channels[i], 0);
+			dispatch_release(_channels[i]);
+		}
+		free(_channels);
+		_channels = NULL;
+	}
+	if (_exitGroup) {
+		dispatch_release(_exitGroup);
+		_exitGroup = nil;
+	}
+
+	[super dealloc];
+}
+
+@end
@@ -22,6 +22,7 @@
 
 #import "GPGRemoteKey.h"
 #import "GPGRemoteUserID.h"
+#import "GPGStringTable.h"
 
 @interface GPGRemoteKey ()
 
@@ -83,7 +84,7 @@
 	
 	NSArray<NSString *> *splitedLine = [listing[0] componentsSeparatedByString:@":"];
 	
-	self.fingerprint = splitedLine[1];
+	self.fingerprint = GPGInternedString(splitedLine[1]);
 	self.algorithm = splitedLine[2].intValue;
 	self.length = splitedLine[3].integerValue;
 	
@@ -21,6 +21,7 @@
 #import "GPGKey.h"
 #import "GPGTransformer.h"
 #import "GPGTypesRW.h"
+#import "GPGStringTable.h"
 
 
 @implementation GPGSignature
@@ -32,12 +33,20 @@
 
 - (instancetype)initWithFingerprint:(NSString *)fingerprint status:(GPGErrorCode)status {
 	if(self = [super init]) {
-		_fingerprint = [fingerprint copy];
+		_fingerprint = [GPGInternedString(fingerprint) retain];
 		_status = status;
 	}
 	return self;
 }
 
+- (void)setFingerprint:(NSString *)fingerprint {
+	fingerprint = GPGInternedString(fingerprint);
+	if (fingerprint != _fingerprint) {
+		[_fingerprint release];
+		_fingerprint = [fingerprint retain];
+	}
+}
+
 - (GPGKey *)primaryKey {
 	return self.key.primaryKey;
 }
@@ -0,0 +1,66 @@
+//
+//  GPGSignatureList.h
+//  Libmacgpg
+//
+
+#import <Foundation/Foundation.h>
+#import "GPGColonListing.h"
+
+@class GPGKey, GPGUserIDSignature;
+
+enum {
+	GPGPackedSignatureRevocation = 1 << 0,
+	GPGPackedSignatureLocal = 1 << 1,
+	GPGPackedSignatureMDCSupport = 1 << 2
+};
+
+/*
+ * The fields of a GPGUserIDSignature without any objects.
+ * The key ID is stored as number, dates as seconds since epoch (0 for none).
+ */
+typedef struct {
+	uint64_t keyID;
+	int64_t creationDate;
+	int64_t expirationDate;
+	GPGKey *signer; // Not retained, like -[GPGUserIDSignature primaryKey].
+	int16_t signatureClass;
+	uint8_t algorithm;
+	uint8_t hashAlgorithm;
+	uint8_t validity;
+	uint8_t flags;
+} GPGPackedSignature;
+
+
+/*
+ * The signatures of a user ID or key, as returned by -signatures.
+ *
+ * A keyring can contain millions of signatures. Instead of an object with its own strings and dates
+ * for every signature, the list stores them in one array of GPGPackedSignature.
+ * A GPGUserIDSignature is only created, when it's requested, and kept for later requests.
+ *
+ * The list is built by GPGKeyManager while parsing and is immutable after it's assigned to a key or user ID.
+ */
+@interface GPGSignatureList : NSArray {
+	GPGPackedSignature *_signatures;
+	NSUInteger _count;
+	NSUInteger _capacity;
+	NSMutableDictionary *_keyIDStrings; // Index -> key ID, for the rare key IDs which aren't 16 hex digits.
+	NSMutableDictionary *_reasons; // Index -> revocation reason.
+	GPGUserIDSignature **_objects; // Created signatures, allocated with the first one.
+}
+
++ (instancetype)list;
+
+// Appends a zeroed signature. The pointer is valid until the next signature is added.
+- (GPGPackedSignature *)addSignatureWithKeyID:(GPGColonField)keyID;
+- (void)setReason:(NSString *)reason forSignature:(GPGPackedSignature *)signature;
+
+// Sets the signer of every signature. Doesn't create GPGUserIDSignatures.
+- (void)setSignersFromKeysByKeyID:(NSDictionary *)keysByKeyID;
+
+// Used by setSignatures of GPGKey and GPGUserID. Only the found signature is created.
+// Valid means the signature was verified by gpg (validity GPGValidityUltimate).
+- (GPGUserIDSignature *)firstRevocationSignatureOnlyValid:(BOOL)onlyValid;
+- (GPGUserIDSignature *)newestValidSignatureByKeyID:(NSString *)keyID;
+
+@end
@@ -0,0 +1,207 @@
+//
+//  GPGSignatureList.m
+//  Libmacgpg
+//
+
+#import "GPGSignatureList.h"
+#import "GPGTypesRW.h"
+#import "GPGStringTable.h"
+
+
+// Parses a key ID of 16 uppercase hex digits, as printed by gpg. Returns NO for anything else,
+// so the key ID can be restored exactly.
+static BOOL packKeyID(const char *bytes, NSUInteger length, uint64_t *keyID) {
+	if (length != 16) {
+		return NO;
+	}
+	uint64_t value = 0;
+	for (NSUInteger i = 0; i < 16; i++) {
+		char c = bytes[i];
+		uint64_t digit;
+		if (c >= '0' && c <= '9') {
+			digit = c - '0';
+		} else if (c >= 'A' && c <= 'F') {
+			digit = c - 'A' + 10;
+		} else {
+			return NO;
+		}
+		value = (value << 4) | digit;
+	}
+	*keyID = value;
+	return YES;
+}
+
+
+@implementation GPGSignatureList
+
++ (instancetype)list {
+	return [[[self alloc] init] autorelease];
+}
+
+- (void)dealloc {
+	if (_objects) {
+		for (NSUInteger i = 0; i < _count; i++) {
+			[_objects[i] release];
+		}
+		free(_objects);
+	}
+	free(_signatures);
+	[_keyIDStrings release];
+	[_reasons release];
+	[super dealloc];
+}
+
+
+#pragma mark Building
+
+- (GPGPackedSignature *)addSignatureWithKeyID:(GPGColonField)keyID {
+	if (_count == _capacity) {
+		_capacity = _capacity ? _capacity * 2 : 8;
+		_signatures = reallocf(_signatures, _capacity * sizeof(GPGPackedSignature));
+		if (!_signatures) {
+			[NSException raise:NSMallocException format:@"Out of memory"];
+		}
+	}
+
+	GPGPackedSignature *signature = &_signatures[_count];
+	memset(signature, 0, sizeof(GPGPackedSignature));
+
+	if (!packKeyID(keyID.bytes, keyID.length, &signature->keyID)) {
+		if (!_keyIDStrings) {
+			_keyIDStrings = [[NSMutableDictionary alloc] init];
+		}
+		[_keyIDStrings setObject:GPGInternedString(GPGColonFieldString(keyID)) forKey:@(_count)];
+	}
+	_count++;
+
+	return signature;
+}
+
+- (void)setReason:(NSString *)reason forSignature:(GPGPackedSignature *)signature {
+	if (!reason) {
+		return;
+	}
+	if (!_reasons) {
+		_reasons = [[NSMutableDictionary alloc] init];
+	}
+	[_reasons setObject:reason forKey:@(signature - _signatures)];
+}
+
+- (void)setSignersFromKeysByKeyID:(NSDictionary *)keysByKeyID {
+	for (NSUInteger i = 0; i < _count; i++) {
+		@autoreleasepool {
+			GPGKey *signer = [keysByKeyID objectForKey:[self keyIDAtIndex:i]];
+			_signatures[i].signer = signer;
+			@synchronized (self) {
+				if (_objects && _objects[i]) {
+					_objects[i].primaryKey = signer;
+				}
+			}
+		}
+	}
+}
+
+
+#pragma mark Signatures
+
+- (NSString *)keyIDAtIndex:(NSUInteger)index {
+	NSString *keyID = [_keyIDStrings objectForKey:@(index)];
+	if (keyID) {
+		return keyID;
+	}
+	char buffer[17];
+	snprintf(buffer, sizeof(buffer), "%016llX", (unsigned long long)_signatures[index].keyID);
+	return GPGInternedStringWithBytes(buffer, 16);
+}
+
+- (GPGUserIDSignature *)newSignatureAtIndex:(NSUInteger)index {
+	const GPGPackedSignature *packed = &_signatures[index];
+	GPGUserIDSignature *signature = [[GPGUserIDSignature alloc] initWithKeyID:[self keyIDAtIndex:index]];
+
+	signature.validity = packed->validity;
+	signature.algorithm = packed->algorithm;
+	signature.hashAlgorithm = packed->hashAlgorithm;
+	signature.signatureClass = packed->signatureClass;
+	if (packed->creationDate) {
+		signature.creationDate = [NSDate dateWithTimeIntervalSince1970:packed->creationDate];
+	}
+	if (packed->expirationDate) {
+		signature.expirationDate = [NSDate dateWithTimeIntervalSince1970:packed->expirationDate];
+	}
+	signature.revocation = (packed->flags & GPGPackedSignatureRevocation) != 0;
+	signature.local = (packed->flags & GPGPackedSignatureLocal) != 0;
+	signature.mdcSupport = (packed->flags & GPGPackedSignatureMDCSupport) != 0;
+	signature.reason = [_reasons objectForKey:@(index)];
+	signature.primaryKey = packed->signer;
+
+	return signature;
+}
+
+- (NSUInteger)count {
+	return _count;
+}
+
+- (id)objectAtIndex:(NSUInteger)index {
+	if (index >= _count) {
+		[NSException raise:NSRangeException format:@"Index %lu beyond bounds [0 .. %lu]", (unsigned long)index, (unsigned long)_count];
+	}
+
+	@synchronized (self) {
+		if (!_objects) {
+			_objects = calloc(_count, sizeof(GPGUserIDSignature *));
+			if (!_objects) {
+				[NSException raise:NSMallocException format:@"Out of memory"];
+			}
+		}
+		if (!_objects[index]) {
+			_objects[index] = [self newSignatureAtIndex:index];
+		}
+		return [[_objects[index] retain] autorelease];
+	}
+}
+
+- (id)copyWithZone:(NSZone *)zone {
+	// Immutable once it's assigned. Copying would create every signature.
+	return [self retain];
+}
+
+
+#pragma mark Search
+
+- (GPGUserIDSignature *)firstRevocationSignatureOnlyValid:(BOOL)onlyValid {
+	for (NSUInteger i = 0; i < _count; i++) {
+		if (!(_signatures[i].flags & GPGPackedSignatureRevocation)) {
+			continue;
+		}
+		if (onlyValid && _signatures[i].validity != GPGValidityUltimate) {
+			continue;
+		}
+		return [self objectAtIndex:i];
+	}
+	return nil;
+}
+
+- (GPGUserIDSignature *)newestValidSignatureByKeyID:(NSString *)keyID {
+	uint64_t packedKeyID = 0;
+	const char *keyIDBytes = keyID.UTF8String;
+	BOOL isPacked = keyIDBytes && packKeyID(keyIDBytes, strlen(keyIDBytes), &packedKeyID);
+
+	NSUInteger newest = NSNotFound;
+	for (NSUInteger i = 0; i < _count; i++) {
+		const GPGPackedSignature *signature = &_signatures[i];
+		if (signature->validity != GPGValidityUltimate || (signature->flags & GPGPackedSignatureRevocation)) {
+			continue;
+		}
+		NSString *keyIDString = [_keyIDStrings objectForKey:@(i)];
+		if (keyIDString ? ![keyIDString isEqualToString:keyID] : (!isPacked || signature->keyID != packedKeyID)) {
+			continue;
+		}
+		if (newest == NSNotFound || _signatures[newest].creationDate == 0 || signature->creationDate > _signatures[newest].creationDate) {
+			newest = i;
+		}
+	}
+
+	return newest == NSNotFound ? nil : [self objectAtIndex:newest];
+}
+
+@end
@@ -0,0 +1,27 @@
+//
+//  GPGStreamSpool.h
+//  Libmacgpg
+//
+
+#import "GPGStream.h"
+
+/*
+ * Reads a stream once and keeps its data, so it can be read any number of times, e.g. by several gpgs.
+ *
+ * Up to a few megabytes are kept in memory. Larger data is written to a file in the temp directory of
+ * GPGTaskLaunchContext, which is deleted with the spool. Every reading stream is independent of the others,
+ * so they can be read on different threads, at any pace and in any order.
+ */
+@interface GPGStreamSpool : NSObject {
+	NSData *_data;
+	NSString *_path;
+}
+
+/* Reads source to its end. Raises an exception if the temporary file can't be written. */
++ (instancetype)spoolWithStream:(GPGStream *)source;
+- (instancetype)initWithStream:(GPGStream *)source;
+
+/* Returns a new stream, which reads all the spooled data from the start. */
+- (GPGStream *)readingStream;
+
+@end
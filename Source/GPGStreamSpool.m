@@ -0,0 +1,105 @@
+//
+//  GPGStreamSpool.m
+//  Libmacgpg
+//
+
+#import "GPGStreamSpool.h"
+#import "GPGMemoryStream.h"
+#import "GPGFileStream.h"
+#import "GPGTaskLaunchContext.h"
+#include <unistd.h>
+
+static const NSUInteger kChunkSize = 64 * 1024;
+static const NSUInteger kMaxMemoryLength = 4 * 1024 * 1024;
+
+
+@interface GPGStreamSpool ()
+- (NSFileHandle *)createFile;
+@end
+
+
+@implementation GPGStreamSpool
+
++ (instancetype)spoolWithStream:(GPGStream *)source {
+	return [[[self alloc] initWithStream:source] autorelease];
+}
+
+- (instancetype)initWithStream:(GPGStream *)source {
+	self = [super init];
+	if (!self) {
+		return nil;
+	}
+
+	if ([source isKindOfClass:[GPGMemoryStream class]]) {
+		// The data is already in memory. The reading streams share it.
+		_data = [(source.offset == 0 ? [source readAllData] : [source readDataToEndOfStream]) retain];
+		return self;
+	}
+
+	NSMutableData *data = [NSMutableData data];
+	NSFileHandle *fileHandle = nil;
+	@try {
+		NSData *chunk;
+		while ((chunk = [source readDataOfLength:kChunkSize]).length > 0) {
+			if (!fileHandle && data.length + chunk.length > kMaxMemoryLength) {
+				fileHandle = [self createFile];
+				[fileHandle writeData:data];
+				data = nil;
+			}
+			if (fileHandle) {
+				[fileHandle writeData:chunk];
+			} else {
+				[data appendData:chunk];
+			}
+		}
+	} @catch (NSException *exception) {
+		[self release];
+		@throw exception;
+	} @finally {
+		[fileHandle closeFile];
+	}
+	_data = [data retain];
+
+	return self;
+}
+
+// Creates the temporary file at _path. It's only readable by the user.
+- (NSFileHandle *)createFile {
+	NSString *tempDir = [GPGTaskLaunchContext currentContext].tempDir;
+	if (!tempDir) {
+		[NSException raise:NSGenericException format:@"createDirectory failed: %@", [NSTemporaryDirectory() stringByAppendingPathComponent:@"org.gpgtools.libmacgpg"]];
+	}
+	char tempPath[PATH_MAX];
+	if (snprintf(tempPath, sizeof(tempPath), "%s/gpgspool.XXXXXX", tempDir.fileSystemRepresentation) >= (int)sizeof(tempPath)) {
+		[NSException raise:NSGenericException format:@"Path too long: %@", tempDir];
+	}
+	int fd = mkstemp(tempPath);
+	if (fd < 0) {
+		[NSException raise:NSGenericException format:@"mkstemp failed: %s", strerror(errno)];
+	}
+	_path = [[[NSFileManager defaultManager] stringWithFileSystemRepresentation:tempPath length:strlen(tempPath)] retain];
+	return [[[NSFileHandle alloc] initWithFileDescriptor:fd closeOnDealloc:YES] autorelease];
+}
+
+- (GPGStream *)readingStream {
+	if (!_path) {
+		return [GPGMemoryStream memoryStreamForReading:_data];
+	}
+	GPGStream *stream = [GPGFileStream fileStreamForReadingAtPath:_path];
+	if (!stream) {
+		[NSException raise:NSGenericException format:@"Unable to read %@", _path];
+	}
+	return stream;
+}
+
+- (void)dealloc {
+	if (_path) {
+		// Open reading streams keep their descriptor and can still read the data.
+		unlink(_path.fileSystemRepresentation);
+	}
+	[_path release];
+	[_data release];
+	[super dealloc];
+}
+
+@end
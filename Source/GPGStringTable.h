@@ -0,0 +1,23 @@
+//
+//  GPGStringTable.h
+//  Libmacgpg
+//
+
+#import <Foundation/Foundation.h>
+
+/*
+ * A process-wide table of interned strings, for the identifiers which occur again and again
+ * in the key model: fingerprints, key IDs, keygrips and user ID hashes.
+ *
+ * Equal strings share one instance, so every copy of a fingerprint costs a pointer and
+ * isEqualToString: returns on the pointer comparison.
+ * The table only references the strings weakly. A string is freed, as soon as no key, signature
+ * or search result uses it anymore, so the table doesn't grow with everything ever seen by the process.
+ */
+
+// Returns the interned instance equal to string. nil for nil.
+NSString *GPGInternedString(NSString *string);
+
+// Like GPGInternedString, for UTF-8 bytes, e.g. a field of a colon listing.
+// No string is created, if the value is already interned.
+NSString *GPGInternedStringWithBytes(const char *bytes, NSUInteger length);
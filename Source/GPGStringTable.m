@@ -0,0 +1,70 @@
+//
+//  GPGStringTable.m
+//  Libmacgpg
+//
+
+#import "GPGStringTable.h"
+
+// The table is split into shards with their own lock, because keys are parsed concurrently.
+#define SHARD_COUNT 16
+
+typedef struct {
+	NSHashTable *strings; // Weak, compared with isEqual:.
+	dispatch_semaphore_t lock;
+} GPGStringTableShard;
+
+static GPGStringTableShard shards[SHARD_COUNT];
+
+
+static void initShards(void) {
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		for (NSUInteger i = 0; i < SHARD_COUNT; i++) {
+			shards[i].strings = [[NSHashTable alloc] initWithOptions:NSPointerFunctionsWeakMemory | NSPointerFunctionsObjectPersonality capacity:1024];
+			shards[i].lock = dispatch_semaphore_create(1);
+		}
+	});
+}
+
+// lookup is only used to find an existing instance. string is added, if there is none, and may be lookup itself.
+static NSString *internString(NSString *lookup, NSString *(^string)(void)) {
+	initShards();
+	GPGStringTableShard *shard = &shards[lookup.hash % SHARD_COUNT];
+
+	dispatch_semaphore_wait(shard->lock, DISPATCH_TIME_FOREVER);
+	// member: returns nil for a string which is being freed. Then a new instance is added.
+	NSString *interned = [shard->strings member:lookup];
+	if (!interned) {
+		interned = string();
+		[shard->strings addObject:interned];
+	}
+	[[interned retain] autorelease];
+	dispatch_semaphore_signal(shard->lock);
+
+	return interned;
+}
+
+NSString *GPGInternedString(NSString *string) {
+	if (!string) {
+		return nil;
+	}
+	return internString(string, ^NSString *{
+		// Never store a mutable string.
+		return [[string copy] autorelease];
+	});
+}
+
+NSString *GPGInternedStringWithBytes(const char *bytes, NSUInteger length) {
+	// A string without its own buffer, only for the lookup.
+	NSString *lookup = [[NSString alloc] initWithBytesNoCopy:(void *)bytes length:length encoding:NSUTF8StringEncoding freeWhenDone:NO];
+	if (!lookup) {
+		return nil;
+	}
+
+	NSString *interned = internString(lookup, ^NSString *{
+		return [[[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding] autorelease];
+	});
+	[lookup release];
+
+	return interned;
+}
@@ -30,7 +30,7 @@
 /**
  GPGTaskHelper configures and launches a GPG 2 process.
  If it's used in a sandboxed environment which doesn't allow
- to directly launch sub-processes using NSTask, it automatically
+ to directly launch sub-processes, it automatically
  connects to the GPGTaskHelper XPC Services which then executes
  the GPG 2 process.
  
@@ -44,7 +44,7 @@
 #import "GPGGlobals.h"
 #import "JailfreeProtocol.h"
 
-@class GPGStream, GPGTaskHelperXPC;
+@class GPGStream, GPGTaskHelperXPC, GPGProcess;
 
 typedef NSData *  (^lp_process_status_t)(NSString *keyword, NSString *value);
 typedef void (^lp_progress_handler_t)(NSUInteger processedBytes, NSUInteger totalBytes);
@@ -75,7 +75,7 @@ typedef void (^lp_progress_handler_t)(NSUInteger processedBytes, NSUInteger tota
     NSData *_errors;
     NSData *_attributes;
     NSUInteger _exitStatus;
-    NSTask *_task;
+    GPGProcess *_task;
     lp_process_status_t _processStatus;
     BOOL _readAttributes;
     NSDictionary *_userIDHint;
@@ -87,6 +87,11 @@ typedef void (^lp_progress_handler_t)(NSUInteger processedBytes, NSUInteger tota
     BOOL _cancelled;
     BOOL _checkForSandbox;
 	BOOL _wroteInputData;
+	BOOL _writingInput;
+	dispatch_queue_t _stdinQueue;
+	dispatch_group_t _collectorGroup;
+	NSMutableArray *_pendingResponses;
+	NSException *_inputException;
 #if defined(__MAC_OS_X_VERSION_MAX_ALLOWED) && __MAC_OS_X_VERSION_MAX_ALLOWED >= 1080
     NSXPCConnection *_sandboxHelper;
 #endif
@@ -141,6 +146,15 @@ typedef void (^lp_progress_handler_t)(NSUInteger processedBytes, NSUInteger tota
  */
 + (BOOL)launchGeneralTask:(NSString *)path withArguments:(NSArray *)arguments wait:(BOOL)wait;
 
+/**
+ Searches the usual install locations and $PATH for an executable with the given name.
+ */
++ (NSString *)findExecutableWithName:(NSString *)executable;
+/**
+ The path of the gpg executable, as resolved by the current GPGTaskLaunchContext.
+ */
++ (NSString *)GPGPath;
+
 + (NSString *)gpgAgentSocket;
 + (BOOL)isPassphraseInGPGAgentCache:(id)key;
 	
@@ -31,6 +31,7 @@
 #import "GPGGlobals.h"
 #import "GPGTaskHelper.h"
 #import "GPGMemoryStream.h"
+#import "GPGFileHandleStream.h"
 #import "NSPipe+NoSigPipe.h"
 #import "NSBundle+Sandbox.h"
 #import "GPGException.h"
@@ -39,7 +40,8 @@
 #import "GPGTaskHelperXPC.h"
 #endif
 #import "GPGTask.h"
-#import "GPGUTF8Argument.h"
+#import "GPGTaskLaunchContext.h"
+#import "GPGProcess.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -108,11 +110,11 @@ void withAutoreleasePool(basic_block_t block)
 @property (nonatomic, retain, readwrite) NSData *status;
 @property (nonatomic, retain, readwrite) NSData *errors;
 @property (nonatomic, retain, readwrite) NSData *attributes;
-@property (nonatomic, retain, readonly) NSTask *task;
+@property (nonatomic, retain, readonly) GPGProcess *task;
 @property (nonatomic, retain) NSDictionary *userIDHint;
 @property (nonatomic, retain) NSDictionary *needPassphraseInfo;
 
-- (void)writeData:(GPGStream *)data pipe:(NSPipe *)pipe close:(BOOL)close;
+- (void)writeResponseData:(NSData *)data;
 
 @end
 
@@ -156,19 +158,8 @@ closeInput = _closeInput;
 }
 
 + (NSString *)GPGPath {
-    static NSString *GPGPath = nil;
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        GPGPath = [GPGTaskHelper findExecutableWithName:@"gpg2"];
-		if (!GPGPath) {
-            GPGPath = [GPGTaskHelper findExecutableWithName:@"gpg"];
-		}
-        [GPGPath retain];
-    });
-	if (!GPGPath) {
-		onceToken = 0;
-	}
-    return GPGPath;
+	// The path is resolved once and cached by the launch context.
+	return [GPGTaskLaunchContext currentContext].gpgPath;
 }
 
 - (id)initWithArguments:(NSArray *)arguments {
@@ -181,93 +172,69 @@ closeInput = _closeInput;
 }
 
 - (NSUInteger)_run {
-	NSString *statusFifoPath = nil;
-	NSString *attributeFifoPath = nil;
-	
-    _task = [[NSTask alloc] init];
-    _task.launchPath = [GPGTaskHelper GPGPath];
-	
-	
-	
-	NSMutableDictionary *environment = [[NSProcessInfo processInfo].environment.mutableCopy autorelease];
-	[environment addEntriesFromDictionary:self.environmentVariables];
-	_task.environment = environment;
-	
-	if (!_task.launchPath || ![[NSFileManager defaultManager] isExecutableFileAtPath:_task.launchPath]) {
+	GPGTaskLaunchContext *context = [GPGTaskLaunchContext currentContext];
+	if (!context.gpgPath) {
         @throw [GPGException exceptionWithReason:@"GPG not found!" errorCode:GPGErrorNotFound];
 	}
 	
 	
 	
-	// Create fifos for status-file and attribute-file.
-	NSMutableArray<NSString *> *mutableArguments = self.arguments.mutableCopy;
-	
-	NSString *tempDir = [NSTemporaryDirectory() stringByAppendingPathComponent:@"org.gpgtools.libmacgpg"];
-	NSError *error = nil;
-	if (![[NSFileManager defaultManager] createDirectoryAtPath:tempDir withIntermediateDirectories:YES attributes:nil error:&error]) {
-		[NSException raise:NSGenericException format:@"createDirectory failed: %@", error.localizedDescription];
-	}
+	// Status and attributes are passed through inherited pipes instead of fifos.
+	// The first additional output is fd 3, the second fd 4.
+	NSMutableArray<NSString *> *mutableArguments = [[self.arguments mutableCopy] autorelease];
+	NSUInteger additionalOutputs = 0;
+	NSInteger statusOutputIndex = -1;
+	NSInteger attributeOutputIndex = -1;
 	
 	NSUInteger index = [mutableArguments indexOfObject:GPGStatusFilePlaceholder];
-	if (index != NSNotFound) {
-		NSString *guid = [NSProcessInfo processInfo].globallyUniqueString ;
-		NSString *fifoName = [NSString stringWithFormat:@"gpgtmp_%@.fifo", guid];
-		statusFifoPath = [tempDir stringByAppendingPathComponent:fifoName];
-		if (mkfifo(statusFifoPath.UTF8String, 0600) != 0) {
-			[NSException raise:NSGenericException format:@"mkfifo failed: %s", strerror(errno)];
-		}
+	if (index != NSNotFound && index > 0) {
+		statusOutputIndex = additionalOutputs++;
 		
-		// Replace the placeholder with the real path.
-		[mutableArguments replaceObjectAtIndex:index withObject:statusFifoPath];
+		// Replace "--status-file placeholder" with "--status-fd 3".
+		[mutableArguments replaceObjectAtIndex:index - 1 withObject:@"--status-fd"];
+		[mutableArguments replaceObjectAtIndex:index withObject:[NSString stringWithFormat:@"%lu", (unsigned long)(3 + statusOutputIndex)]];
 	}
 	
 	index = [mutableArguments indexOfObject:GPGAttributeFilePlaceholder];
-	if (index != NSNotFound) {
-		NSString *guid = [NSProcessInfo processInfo].globallyUniqueString ;
-		NSString *fifoName = [NSString stringWithFormat:@"gpgtmp_%@.fifo", guid];
-		attributeFifoPath = [tempDir stringByAppendingPathComponent:fifoName];
-		
-		if (mkfifo(attributeFifoPath.UTF8String, 0600) != 0) {
-			[NSException raise:NSGenericException format:@"mkfifo failed: %s", strerror(errno)];
-		}
+	if (index != NSNotFound && index > 0) {
+		attributeOutputIndex = additionalOutputs++;
 		
-		// Replace the placeholder with the real path.
-		[mutableArguments replaceObjectAtIndex:index withObject:attributeFifoPath];
-	}
-	
-	// Convert all arguments to GPGUTF8Argument, so umlauts are correctly utf-8 encoded.
-	NSUInteger count = mutableArguments.count;
-	for (NSUInteger i = 0; i < count; i++) {
-		GPGUTF8Argument *argument = [GPGUTF8Argument stringWithString:mutableArguments[i]];
-		mutableArguments[i] = argument;
+		// Replace "--attribute-file placeholder" with "--attribute-fd 3" or "--attribute-fd 4".
+		[mutableArguments replaceObjectAtIndex:index - 1 withObject:@"--attribute-fd"];
+		[mutableArguments replaceObjectAtIndex:index withObject:[NSString stringWithFormat:@"%lu", (unsigned long)(3 + attributeOutputIndex)]];
 	}
 	
 	
-	_task.arguments = mutableArguments;
-	[mutableArguments release];
-
+	_task = [[GPGProcess launchedProcessWithPath:context.gpgPath
+									   arguments:mutableArguments
+										 context:context
+							environmentVariables:self.environmentVariables
+							   additionalOutputs:additionalOutputs] retain];
 	
-
-	_task.standardInput = [NSPipe pipe].noSIGPIPE;
-	_task.standardOutput = [NSPipe pipe].noSIGPIPE;
-	_task.standardError = [NSPipe pipe].noSIGPIPE;
-
-	
-    GPGDebugLog(@"$> %@ %@", _task.launchPath, [_task.arguments componentsJoinedByString:@" "]);
-	[_task launch];
+	int statusFD = statusOutputIndex >= 0 ? 3 + (int)statusOutputIndex : -1;
+	int attributeFD = attributeOutputIndex >= 0 ? 3 + (int)attributeOutputIndex : -1;
 
 	
 	_totalInData = self.inData.length;
 	
     __block NSException *blockException = nil;
-    __block NSData *stderrData = nil;
-    __block NSData *statusData = nil;
-    __block NSData *attributeData = nil;
     __block NSObject *lock = [[[NSObject alloc] init] autorelease];
+	NSMutableData *stderrData = [NSMutableData data];
+	NSMutableData *statusData = statusFD >= 0 ? [NSMutableData data] : nil;
+	NSMutableData *attributeData = attributeFD >= 0 ? [NSMutableData data] : nil;
+	NSMutableData *statusBuffer = [NSMutableData data];
 	
 	
-	dispatch_queue_t queue = dispatch_queue_create("org.gpgtools.libmacgpg.gpgTaskHelper", DISPATCH_QUEUE_CONCURRENT);
-	dispatch_group_t collectorGroup = dispatch_group_create();
+	// The pipes are serviced by dispatch_io. The handlers are only called when data is available,
+	// so no thread is blocked while gpg is running, regardless of how many tasks run at once.
+	// stdout, stderr and attributes are collected on one serial queue. Status lines are processed
+	// on their own serial queue, because the processStatus callback might block.
+	dispatch_queue_t outputQueue = dispatch_queue_create("org.gpgtools.libmacgpg.gpgTaskHelper.output", NULL);
+	dispatch_queue_t statusQueue = dispatch_queue_create("org.gpgtools.libmacgpg.gpgTaskHelper.status", NULL);
+	_stdinQueue = dispatch_queue_create("org.gpgtools.libmacgpg.gpgTaskHelper.stdin", NULL);
+	_pendingResponses = [[NSMutableArray alloc] init];
+	_collectorGroup = dispatch_group_create();
+	dispatch_group_t collectorGroup = _collectorGroup;
 	
 	// The data is written to the pipe as soon as gpg issues the status
 	// BEGIN_ENCRYPTION or BEGIN_SIGNING. See processStatus.
@@ -287,63 +254,66 @@ closeInput = _closeInput;
 		}
 	}
 	if (shouldWriteInput) {
-		dispatch_group_async(collectorGroup, queue, ^{
-			runBlockAndRecordExceptionSyncronized(^{
-				[self writeInputData];
-			}, &lock, &blockException);
-		});
+		[self writeInputData];
 		_wroteInputData = YES;
 	}
 	
 	
-	dispatch_group_async(collectorGroup, queue, ^{
-		runBlockAndRecordExceptionSyncronized(^{
-			NSData *data;
-			NSFileHandle *stdoutFH = [_task.standardOutput fileHandleForReading];
-			while ((data = [stdoutFH readDataOfLength:kDataBufferSize]) && data.length > 0) {
+	__block BOOL outputFailed = NO;
+	dispatch_group_enter(collectorGroup);
+	[_task readFileDescriptor:STDOUT_FILENO queue:outputQueue handler:^(NSData *data, BOOL done) {
+		if (data && !outputFailed) {
+			runBlockAndRecordExceptionSynchronizedWithHandlers(^{
 				withAutoreleasePool(^{
 					[self->_output writeData:data];
 				});
-			}
-		}, &lock, &blockException);
-	});
+			}, ^{
+				outputFailed = YES;
+			}, NULL, &lock, &blockException);
+		}
+		if (done) {
+			dispatch_group_leave(collectorGroup);
+		}
+	}];
 	
-	dispatch_group_async(collectorGroup, queue, ^{
-		runBlockAndRecordExceptionSyncronized(^{
-			NSMutableData *mutableData = [NSMutableData data];
-			NSData *data;
-			NSFileHandle *stderrFH = [_task.standardError fileHandleForReading];
-			while ((data = [stderrFH readDataOfLength:kDataBufferSize]) && data.length > 0) {
-				[mutableData appendData:data];
-			}
-			// Needs to be retained to survive the block.
-			stderrData = [mutableData copy];
-		}, &lock, &blockException);
-	});
+	dispatch_group_enter(collectorGroup);
+	[_task readFileDescriptor:STDERR_FILENO queue:outputQueue handler:^(NSData *data, BOOL done) {
+		if (data) {
+			[stderrData appendData:data];
+		}
+		if (done) {
+			dispatch_group_leave(collectorGroup);
+		}
+	}];
 	
-	if (attributeFifoPath) {
-		dispatch_group_async(collectorGroup, queue, ^{
-			runBlockAndRecordExceptionSyncronized(^{
-				NSMutableData *mutableData = [NSMutableData data];
-				NSData *data;
-				NSFileHandle *stderrFH = [NSFileHandle fileHandleForReadingAtPath:attributeFifoPath];
-				while ((data = [stderrFH readDataOfLength:kDataBufferSize]) && data.length > 0) {
-					[mutableData appendData:data];
-				}
-				// Needs to be retained to survive the block.
-				attributeData = [mutableData copy];
-			}, &lock, &blockException);
-		});
+	if (attributeData) {
+		dispatch_group_enter(collectorGroup);
+		[_task readFileDescriptor:attributeFD queue:outputQueue handler:^(NSData *data, BOOL done) {
+			if (data) {
+				[attributeData appendData:data];
+			}
+			if (done) {
+				dispatch_group_leave(collectorGroup);
+			}
+		}];
 	}
 
-	if (statusFifoPath) {
-		dispatch_group_async(collectorGroup, queue, ^{
-			runBlockAndRecordExceptionSyncronized(^{
-				statusData = [self readStatusFile:statusFifoPath];
-				// Needs to be retained to survive the block.
-				[statusData retain];
-			}, &lock, &blockException);
-		});
+	if (statusData) {
+		__block BOOL statusFailed = NO;
+		dispatch_group_enter(collectorGroup);
+		[_task readFileDescriptor:statusFD queue:statusQueue handler:^(NSData *data, BOOL done) {
+			// After an exception, the status is still read, so gpg doesn't block, but no longer processed.
+			if (data && !statusFailed) {
+				runBlockAndRecordExceptionSynchronizedWithHandlers(^{
+					[self processStatusData:data buffer:statusBuffer statusData:statusData];
+				}, ^{
+					statusFailed = YES;
+				}, NULL, &lock, &blockException);
+			}
+			if (done) {
+				dispatch_group_leave(collectorGroup);
+			}
+		}];
 	}
 
 	
@@ -351,34 +321,24 @@ closeInput = _closeInput;
 	// Wait for all jobs to complete.
 	dispatch_group_wait(collectorGroup, DISPATCH_TIME_FOREVER);
 	
-	dispatch_release(collectorGroup);
-	dispatch_release(queue);
+	dispatch_release(outputQueue);
+	dispatch_release(statusQueue);
 
-	[_task threadSafeWaitUntilExit];
+	[_task waitUntilExit];
 
 	
-	
-	
-	if (statusFifoPath) {
-		[[NSFileManager defaultManager] removeItemAtPath:statusFifoPath error:nil];
-	}
-	if (attributeFifoPath) {
-		[[NSFileManager defaultManager] removeItemAtPath:attributeFifoPath error:nil];
+	if (!blockException && _inputException) {
+		blockException = [_inputException retain];
 	}
 	
     if (blockException && !_cancelled && !_pinentryCancelled) {
-		[statusData release];
-		[stderrData release];
-		[attributeData release];
-        @throw blockException;
+        @throw [blockException autorelease];
 	}
+	[blockException release];
 	
-	self.status = statusData;
-    [statusData release];
-	self.errors = stderrData;
-	[stderrData release];
-    self.attributes = attributeData;
-	[attributeData release];
+	self.status = statusData ? [[statusData copy] autorelease] : nil;
+	self.errors = [[stderrData copy] autorelease];
+    self.attributes = attributeData ? [[attributeData copy] autorelease] : nil;
 	
     _exitStatus = _task.terminationStatus;
     
@@ -424,7 +384,8 @@ closeInput = _closeInput;
 	
 	NSDictionary *result = nil;
 	@try {
-		result = [xpcTask launchGPGWithArguments:self.arguments data:_inData.readAllData readAttributes:self.readAttributes closeInput:_closeInput];
+		// Input and output are streamed, so they are never held in memory as a whole.
+		result = [xpcTask launchGPGWithArguments:self.arguments input:_inData output:_output readAttributes:self.readAttributes closeInput:_closeInput];
 	}
 	@catch (NSException *exception) {
 		[xpcTask release];
@@ -434,8 +395,6 @@ closeInput = _closeInput;
 	}
 	
 	
-	if([result objectForKey:@"output"])
-		[_output writeData:[result objectForKey:@"output"]];
 	[_output release];
 	_output = nil;
 	
@@ -467,116 +426,158 @@ closeInput = _closeInput;
         return;
     }
 	
-	NSPipe *stdinPipe = self.task.standardInput;
+	GPGStream *input = [[self.inData retain] autorelease];
+    self.inData = nil;
+	
+	// The input is written chunk by chunk. The next chunk is only read from the stream,
+	// when the previous one was written, so no thread is blocked while gpg doesn't read.
+	dispatch_group_enter(_collectorGroup);
+	dispatch_async(_stdinQueue, ^{
+		_writingInput = YES;
+		[self writeNextChunkOfStream:input];
+	});
+}
 
-	[self writeData:self.inData pipe:stdinPipe close:_closeInput];
+/* Must be called on _stdinQueue. */
+- (void)writeNextChunkOfStream:(GPGStream *)input {
+	NSData *data = nil;
+	@try {
+		data = [input readDataOfLength:kDataBufferSize];
+	}
+	@catch (NSException *exception) {
+		_inputException = [exception retain];
+		[self inputWritten:NO];
+		return;
+	}
 	
-    self.inData = nil;
+	if (data.length == 0) {
+		[self inputWritten:YES];
+		return;
+	}
+	
+	[_task writeToStandardInput:data queue:_stdinQueue completion:^(int error) {
+		if (error) {
+			// gpg closed stdin or was terminated. Not an error by itself, the exit status tells what happened.
+			[self inputWritten:NO];
+		} else {
+			[self writeNextChunkOfStream:input];
+		}
+	}];
+}
+
+/* Must be called on _stdinQueue. */
+- (void)inputWritten:(BOOL)success {
+	_writingInput = NO;
+	
+	if (success) {
+		// Responses are written after the input, so they aren't mixed up with it.
+		for (NSData *response in _pendingResponses) {
+			[_task writeToStandardInput:response queue:_stdinQueue completion:nil];
+		}
+		if (_closeInput) {
+			[_task closeStandardInput];
+		}
+	}
+	[_pendingResponses removeAllObjects];
+	
+	dispatch_group_leave(_collectorGroup);
 }
 
-- (void)writeData:(GPGStream *)data pipe:(NSPipe *)pipe close:(BOOL)close {
+- (void)writeResponseData:(NSData *)data {
     // If the task was already shutdown, it's still possible that
     // responds to status messages have to be processed in XPC mode.
     // In that case however the pipe no longer exists, so don't do anything.
-    if(!pipe)
-        return;
-    NSFileHandle *ofh = [pipe fileHandleForWriting];
-    GPGStream *input = data;
-    NSData *tempData = nil;
-    
-    @try {
-        while ((tempData = [input readDataOfLength:kDataBufferSize]) && tempData.length > 0) {
-			@autoreleasepool {
-				// NSMutableData is required to prevent an uncatchable exception in -writeData:
-				tempData = [NSMutableData dataWithData:tempData];
-				
-				[ofh writeData:tempData];
-			}
-        }
-        
-        if(close) {
-            [ofh closeFile];
-        }
-    }
-    @catch (NSException *exception) {
-        // If the task is no longer running, there's no need to throw this exception
-        // since it's expected.
-        if(!self.completed)
-            @throw exception;
-        return;
-    }
+	if (!_task || !_stdinQueue) {
+		return;
+	}
+	
+	dispatch_async(_stdinQueue, ^{
+		if (_writingInput) {
+			[_pendingResponses addObject:data];
+		} else {
+			[_task writeToStandardInput:data queue:_stdinQueue completion:nil];
+		}
+	});
 }
 
+- (void)closeStandardInput {
+	if (!_task || !_stdinQueue) {
+		return;
+	}
+	
+	dispatch_async(_stdinQueue, ^{
+		if (_writingInput) {
+			// Close as soon as the input was written.
+			_closeInput = YES;
+		} else {
+			[_task closeStandardInput];
+		}
+	});
+}
 
-- (NSData *)readStatusFile:(NSString *)statusFile {
+
+/**
+ Processes status output as it is read. Complete lines are processed, the rest
+ is kept in currentData until more data arrives.
+ */
+- (void)processStatusData:(NSData *)readData buffer:(NSMutableData *)currentData statusData:(NSMutableData *)statusData {
 	NSData *nl = @"\n".UTF8Data;
 	NSData *space = @" ".UTF8Data;
 	NSData *statusPrefix = GPG_STATUS_PREFIX.UTF8Data;
 	NSUInteger statusPrefixLength = statusPrefix.length;
 	
-	NSMutableData *statusData = [NSMutableData data];
-	NSMutableData *currentData = [NSMutableData data];
+	[currentData appendData:readData];
 	
-	NSFileHandle *fileHandle = [NSFileHandle fileHandleForReadingAtPath:statusFile];
-
+	NSUInteger currentDataLength = currentData.length;
 	
-	NSData *readData = nil;
-	while ((readData = fileHandle.availableData) && readData.length) {
-		[currentData appendData:readData];
-		
-		NSUInteger currentDataLength = currentData.length;
+	NSRange searchRange;
+	searchRange.location = 0;
+	searchRange.length = currentDataLength;
+	
+	NSUInteger nextLineStart = 0;
+	NSRange lineRange;
+	NSRange nlRange;
+	
+	// Process the status output line by line.
+	while ((nlRange = [currentData rangeOfData:nl options:0 range:searchRange]).length > 0) {
+
+		// Find th erange of the current line.
+		lineRange.location = nextLineStart;
+		lineRange.length = nlRange.location - lineRange.location + 1;
+		nextLineStart = nlRange.location + 1;
 		
-		NSRange searchRange;
-		searchRange.location = 0;
-		searchRange.length = currentDataLength;
+		// Get the data of the current line.
+		NSData *lineData = [currentData subdataWithRange:lineRange];
 		
-		NSUInteger nextLineStart = 0;
-		NSRange lineRange;
-		NSRange nlRange;
 		
-		// Process the status output line by line.
-		while ((nlRange = [currentData rangeOfData:nl options:0 range:searchRange]).length > 0) {
+		if ([lineData rangeOfData:statusPrefix options:NSDataSearchAnchored range:NSMakeRange(0, lineData.length)].length > 0) {
+			// Line is a status line. Line starts with "[GNUPG:] ".
 
-			// Find th erange of the current line.
-			lineRange.location = nextLineStart;
-			lineRange.length = nlRange.location - lineRange.location + 1;
-			nextLineStart = nlRange.location + 1;
-			
-			// Get the data of the current line.
-			NSData *lineData = [currentData subdataWithRange:lineRange];
+			[statusData appendData:lineData];
 			
+			NSRange statusRange = NSMakeRange(statusPrefixLength, lineData.length - statusPrefixLength - 1);
+			NSRange spaceRange = [lineData rangeOfData:space options:0 range:statusRange];
 			
-			if ([lineData rangeOfData:statusPrefix options:NSDataSearchAnchored range:NSMakeRange(0, lineData.length)].length > 0) {
-				// Line is a status line. Line starts with "[GNUPG:] ".
-
-				[statusData appendData:lineData];
-				
-				NSRange statusRange = NSMakeRange(statusPrefixLength, lineData.length - statusPrefixLength - 1);
-				NSRange spaceRange = [lineData rangeOfData:space options:0 range:statusRange];
-				
-				// Split line in keyword and value.
-				NSString *keyword, *value = @"";
-				if (spaceRange.length == 0) {
-					keyword = [lineData subdataWithRange:statusRange].gpgString;
-				} else {
-					keyword = [lineData subdataWithRange:NSMakeRange(statusRange.location, spaceRange.location - statusRange.location)].gpgString;
-					value = [lineData subdataWithRange:NSMakeRange(spaceRange.location + 1, statusRange.location + statusRange.length - spaceRange.location - 1)].gpgString;
-				}
-				
-				[self processStatusWithKeyword:keyword value:value];
+			// Split line in keyword and value.
+			NSString *keyword, *value = @"";
+			if (spaceRange.length == 0) {
+				keyword = [lineData subdataWithRange:statusRange].gpgString;
 			} else {
-				// This should not happen. But it is not a real problem.
+				keyword = [lineData subdataWithRange:NSMakeRange(statusRange.location, spaceRange.location - statusRange.location)].gpgString;
+				value = [lineData subdataWithRange:NSMakeRange(spaceRange.location + 1, statusRange.location + statusRange.length - spaceRange.location - 1)].gpgString;
 			}
 			
-			searchRange.location = nextLineStart;
-			searchRange.length = currentDataLength - searchRange.location;
+			[self processStatusWithKeyword:keyword value:value];
+		} else {
+			// This should not happen. But it is not a real problem.
 		}
 		
-		NSRange rangeToRemove = NSMakeRange(0, searchRange.location);
-		[currentData replaceBytesInRange:rangeToRemove withBytes:"" length:0];
+		searchRange.location = nextLineStart;
+		searchRange.length = currentDataLength - searchRange.location;
 	}
 	
-	return [[statusData copy] autorelease];
+	NSRange rangeToRemove = NSMakeRange(0, searchRange.location);
+	[currentData replaceBytesInRange:rangeToRemove withBytes:"" length:0];
 }
 
 
@@ -628,10 +629,7 @@ closeInput = _closeInput;
                 if(response)
                     [self respond:response];
                 else {
-                    NSPipe *cmdPipe = self.task.standardInput;
-                    if (cmdPipe) {
-                        [[cmdPipe fileHandleForWriting] closeFile];
-                    }
+                    [self closeStandardInput];
                 }
             }
             break;
@@ -692,7 +690,6 @@ closeInput = _closeInput;
 	// Ignore call, if response is empty data.
 	if([response length] == 0)
 		return;
-	NSPipe *cmdPipe = nil;
     
     NSData *NL = [@"\n" dataUsingEncoding:NSASCIIStringEncoding];
     
@@ -700,26 +697,13 @@ closeInput = _closeInput;
     [responseData appendData:[response isKindOfClass:[NSData class]] ? response : [[response description] dataUsingEncoding:NSUTF8StringEncoding]];
     if([responseData rangeOfData:NL options:NSDataSearchBackwards range:NSMakeRange(0, [responseData length])].location == NSNotFound)
         [responseData appendData:[@"\n" dataUsingEncoding:NSUTF8StringEncoding]];
-    GPGStream *responseStream = [GPGMemoryStream memoryStream];
-
-    @try {
-        cmdPipe = self.task.standardInput;
-    }
-    @catch (NSException *exception) {
-    }
 
     if(self.completed) {
         [responseData release];
         return;
     }
 
-    if(!cmdPipe) {
-        [responseData release];
-        return;
-    }
-
-    [responseStream writeData:responseData];
-    [self writeData:responseStream pipe:cmdPipe close:NO];
+    [self writeResponseData:responseData];
 	[responseData release];
 }
 
@@ -814,12 +798,7 @@ closeInput = _closeInput;
 	}
 
 	// Close all pipes, otherwise SIGTERM is ignored it seems.
-	[[_task.standardInput fileHandleForReading] closeFile];
-	[[_task.standardInput fileHandleForWriting] closeFile];
-	[[_task.standardOutput fileHandleForReading] closeFile];
-	[[_task.standardOutput fileHandleForWriting] closeFile];
-	[[_task.standardError fileHandleForReading] closeFile];
-	[[_task.standardError fileHandleForWriting] closeFile];
+	[_task closePipes];
 	[_task terminate];
 
     _cancelled = YES;
@@ -833,7 +812,8 @@ closeInput = _closeInput;
 		[result setObject:self.errors forKey:@"errors"];
 	if(self.attributes)
 		[result setObject:self.attributes forKey:@"attributes"];
-	if(self.output)
+	// Streamed output was already delivered while the task was running.
+	if(self.output && ![self.output isKindOfClass:[GPGFileHandleStream class]])
 		[result setObject:[self.output readAllData] forKey:@"output"];
 	[result setObject:[NSNumber numberWithUnsignedInteger:self.exitStatus] forKey:@"exitcode"];
     
@@ -1053,6 +1033,16 @@ closeInput = _closeInput;
     [_attributes release];
     [_task release];
 	_task = nil;
+	if (_stdinQueue) {
+		dispatch_release(_stdinQueue);
+		_stdinQueue = nil;
+	}
+	if (_collectorGroup) {
+		dispatch_release(_collectorGroup);
+		_collectorGroup = nil;
+	}
+	[_pendingResponses release];
+	[_inputException release];
 	[_processStatus release];
     [_userIDHint release];
     [_needPassphraseInfo release];
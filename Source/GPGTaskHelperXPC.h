@@ -45,10 +45,12 @@
  */
 #import <Libmacgpg/JailfreeProtocol.h>
 
+@class GPGStream, GPGJailfreeConnection;
+
 @interface GPGTaskHelperXPC : NSObject <Jail> {
 	NSData *(^_processStatus)(NSString *keyword, NSString *value);
 	void (^_progressHandler)(NSUInteger processedBytes, NSUInteger totalBytes);
-	NSXPCConnection *_connection;
+	GPGJailfreeConnection *_connection;
 	dispatch_semaphore_t _taskLock;
 	id <Jailfree> _jailfree;
 	BOOL _wasShutdown;
@@ -56,10 +58,21 @@
 	NSException *_callError;
 	NSException *_taskError;
 	BOOL _success;
+	BOOL _usesListenerEndpoint;
 }
 
 - (id)init;
+/**
+ * Connects to the service behind the endpoint instead of org.gpgtools.Libmacgpg.xpc.
+ * Allows to run the service in-process, e.g. for testing.
+ */
+- (id)initWithListenerEndpoint:(NSXPCListenerEndpoint *)endpoint;
 - (NSDictionary *)launchGPGWithArguments:(NSArray *)arguments data:(NSData *)data readAttributes:(BOOL)readAttributes closeInput:(BOOL)closeInput;
+/**
+ * Streams input to and output from the xpc service through pipes, so neither has to be held in memory.
+ * input may be nil. The returned dictionary contains no output.
+ */
+- (NSDictionary *)launchGPGWithArguments:(NSArray *)arguments input:(GPGStream *)input output:(GPGStream *)output readAttributes:(BOOL)readAttributes closeInput:(BOOL)closeInput;
 - (BOOL)launchGeneralTask:(NSString *)path withArguments:(NSArray *)arguments wait:(BOOL)wait;
 - (void)shutdown;
 - (NSString *)loadConfigFileAtPath:(NSString *)path;
@@ -32,10 +32,14 @@
 #import "Libmacgpg.h"
 #import "GPGTaskHelper.h"
 #import "GPGTaskHelperXPC.h"
+#import "GPGJailfreeConnection.h"
+#import "NSPipe+NoSigPipe.h"
+
+static const NSUInteger kXPCStreamChunkSize = 65536;
 
 @interface GPGTaskHelperXPC ()
 
-@property (nonatomic) NSXPCConnection *connection;
+@property (nonatomic) GPGJailfreeConnection *connection;
 @property (nonatomic) dispatch_semaphore_t taskLock;
 @property (nonatomic) BOOL wasShutdown;
 @property (nonatomic, retain, readwrite) NSException *connectionError;
@@ -52,52 +56,31 @@
 #pragma mark - XPC connection helpers
 
 - (id)init {
+	return [self initWithConnection:[GPGJailfreeConnection sharedConnection]];
+}
+
+- (id)initWithListenerEndpoint:(NSXPCListenerEndpoint *)endpoint {
+	GPGJailfreeConnection *connection = [[[GPGJailfreeConnection alloc] initWithListenerEndpoint:endpoint] autorelease];
+	self = [self initWithConnection:connection];
+	if(self) {
+		_usesListenerEndpoint = YES;
+	}
+	return self;
+}
+
+- (id)initWithConnection:(GPGJailfreeConnection *)connection {
 	self = [super init];
 	if(self) {
-		_connection = [[NSXPCConnection alloc] initWithMachServiceName:JAILFREE_XPC_NAME options:0];
-		_connection.remoteObjectInterface = [NSXPCInterface interfaceWithProtocol:@protocol(Jailfree)];
-		_connection.exportedInterface = [NSXPCInterface interfaceWithProtocol:@protocol(Jail)];
-		_connection.exportedObject = self;
+		// The connection is shared with other requests and outlives this object.
+		// Status and progress callbacks are passed with each request instead of
+		// using the connection's exported object.
+		_connection = [connection retain];
 		
 		_success = false;
-
-		// The invalidation handler is called when there's a problem establishing
-		// the connection to the xpc service or it can't be found at all.
-		__block GPGTaskHelperXPC *weakSelf = self;
-		_connection.invalidationHandler = ^{
-			// Signal any outstanding tasks that they are done.
-			// This handler is always called, when the connection is shutdown,
-			// but more importantly also, when no connection could be established,
-			// so catch that!
-			if(weakSelf.wasShutdown)
-				return;
-			
-			weakSelf.connectionError = [GPGException exceptionWithReason:@"[Libmacgpg] Failed to establish connection to org.gpgtools.Libmacgpg.xpc" errorCode:GPGErrorXPCConnectionError];
-			
-			[weakSelf completeTaskWithFailure];
-		};
-		
 		_taskLock = dispatch_semaphore_create(0);
 		
-		// Setup the remote object with error handler.
 		_connectionError = nil;
 		_callError = nil;
-		
-		// The error handler is invoked in the following cases:
-		// - The xpc service crashes due to some error (for example overrelease.)
-		// - If the xpc service is killed (process killed, also with -9)
-		// - If the xpc service is unloaded with launchctl unload.
-		// - If the xpc service is removed with launchctl remove.
-		_jailfree = [_connection remoteObjectProxyWithErrorHandler:^(NSError *error) {
-			// The connection has been invalidated by ourselves.
-			// No need to log anything.
-			if(weakSelf.wasShutdown)
-				return;
-			
-			weakSelf.callError = [GPGException exceptionWithReason:@"[Libmacgpg] Failed to invoke XPC method" errorCode:GPGErrorXPCConnectionInterruptedError];
-			
-			[weakSelf completeTaskWithFailure];
-		}];
 	}
 	return self;
 }
@@ -126,13 +109,36 @@
 	// NSXPCConnection is not checking if the binary for the xpc service actually
 	// exists and hence doesn't invoke an error handler if it doesn't.
 	// So we do the check for it, and throw an error if necessary.
-	if(![self healthyXPCBinaryExists]) {
+	if(!_usesListenerEndpoint && ![self healthyXPCBinaryExists]) {
 		self.connectionError = [GPGException exceptionWithReason:@"[Libmacgpg] The xpc service binary is not available. Please re-install GPGTools from https://gpgtools.org" errorCode:GPGErrorXPCBinaryError];
 		[self shutdownAndThrowError];
 	}
-	// Resume will trigger the invalidationHandler if the connection can't
-	// be established, for example, if the xpc service is not registered.
-	[_connection resume];
+	
+	// The error handler is invoked in the following cases:
+	// - The xpc service crashes due to some error (for example overrelease.)
+	// - If the xpc service is killed (process killed, also with -9)
+	// - If the xpc service is unloaded with launchctl unload.
+	// - If the xpc service is removed with launchctl remove.
+	// It's only invoked for this request, other requests on the shared connection
+	// get their own error handler.
+	__block GPGTaskHelperXPC *weakSelf = self;
+	_jailfree = [[_connection remoteObjectProxyWithErrorHandler:^(NSError *error) {
+		// The request has been completed or cancelled by ourselves.
+		// No need to log anything.
+		if(weakSelf.wasShutdown)
+			return;
+		
+		weakSelf.callError = [GPGException exceptionWithReason:@"[Libmacgpg] Failed to invoke XPC method" errorCode:GPGErrorXPCConnectionInterruptedError];
+		
+		[weakSelf completeTaskWithFailure];
+	}] retain];
+	
+	// The connection is checked before it's used for the first time,
+	// which fails if the xpc service is not registered or doesn't answer.
+	if(!_jailfree) {
+		self.connectionError = [GPGException exceptionWithReason:@"[Libmacgpg] Failed to establish connection to org.gpgtools.Libmacgpg.xpc" errorCode:GPGErrorXPCConnectionError];
+		[self shutdownAndThrowError];
+	}
 }
 
 - (void)waitForTaskToCompleteAndShutdown:(BOOL)shutdown throwExceptionIfNecessary:(BOOL)throwException {
@@ -188,35 +194,78 @@
 #pragma mark XPC service methods
 
 - (NSDictionary *)launchGPGWithArguments:(NSArray *)arguments data:(NSData *)data readAttributes:(BOOL)readAttributes closeInput:(BOOL)closeInput {
+	// The output is streamed back like any other output. This keeps status and progress
+	// callbacks per request, which is required on the shared connection.
+	GPGMemoryStream *input = data ? [GPGMemoryStream memoryStreamForReading:data] : nil;
+	GPGMemoryStream *output = [GPGMemoryStream memoryStream];
+	
+	NSMutableDictionary *result = [[[self launchGPGWithArguments:arguments input:input output:output readAttributes:readAttributes closeInput:closeInput] mutableCopy] autorelease];
+	[result setObject:[output readAllData] forKey:@"output"];
+	
+	return result;
+}
+
+- (NSDictionary *)launchGPGWithArguments:(NSArray *)arguments input:(GPGStream *)input output:(GPGStream *)output readAttributes:(BOOL)readAttributes closeInput:(BOOL)closeInput {
 	[self prepareTask];
 	
 	NSException * __block taskError = nil;
+	NSException * __block streamError = nil;
 	NSMutableDictionary *result = [[NSMutableDictionary alloc] initWithCapacity:0];
 	
-	[_jailfree launchGPGWithArguments:arguments data:data readAttributes:readAttributes closeInput:closeInput reply:^(NSDictionary *info) {
-		// Received an error? Convert it to an NSException and out of here.
-		if([info objectForKey:@"exception"]) {
-			NSDictionary *exceptionInfo = [info objectForKey:@"exception"];
-			NSException *exception = nil;
-			if(![exceptionInfo objectForKey:@"errorCode"]) {
-				exception = [NSException exceptionWithName:[exceptionInfo objectForKey:@"name"] reason:[exceptionInfo objectForKey:@"reason"] userInfo:nil];
+	// The service reads the input from one pipe and writes the output to another.
+	// Only one chunk is held in memory at a time, the pipes provide the back-pressure.
+	NSPipe *inputPipe = input ? [NSPipe pipe].noSIGPIPE : nil;
+	NSPipe *outputPipe = [NSPipe pipe].noSIGPIPE;
+	dispatch_group_t streamGroup = dispatch_group_create();
+	dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	
+	if (inputPipe) {
+		NSFileHandle *inputFH = inputPipe.fileHandleForWriting;
+		dispatch_group_async(streamGroup, queue, ^{
+			@try {
+				NSData *data;
+				while ((data = [input readDataOfLength:kXPCStreamChunkSize]) && data.length > 0) {
+					@autoreleasepool {
+						// NSMutableData is required to prevent an uncatchable exception in -writeData:
+						[inputFH writeData:[NSMutableData dataWithData:data]];
+					}
+				}
 			}
-			else {
-				exception = [GPGException exceptionWithReason:[exceptionInfo objectForKey:@"reason"] errorCode:[[exceptionInfo objectForKey:@"errorCode"] unsignedIntValue]];
+			@catch (NSException *exception) {
+				// gpg doesn't need all of the input, or the service is gone.
+				// In both cases the reply tells what happened.
 			}
-			
-			taskError = [exception retain];
+			@finally {
+				[inputFH closeFile];
+			}
+		});
+	}
+	
+	NSFileHandle *outputFH = outputPipe.fileHandleForReading;
+	dispatch_group_async(streamGroup, queue, ^{
+		@try {
+			NSData *data;
+			while ((data = [outputFH readDataOfLength:kXPCStreamChunkSize]) && data.length > 0) {
+				@autoreleasepool {
+					[output writeData:data];
+				}
+			}
+		}
+		@catch (NSException *exception) {
+			streamError = [exception retain];
+		}
+	});
+	
+	[_jailfree launchGPGWithArguments:arguments input:inputPipe.fileHandleForReading inputLength:(NSUInteger)input.length output:outputPipe.fileHandleForWriting readAttributes:readAttributes closeInput:closeInput callbacks:self reply:^(NSDictionary *info) {
+		if([info objectForKey:@"exception"]) {
+			taskError = [[self exceptionFromInfo:[info objectForKey:@"exception"]] retain];
 			[self completeTaskWithFailure];
-			
 			return;
 		}
 		
-        // If there's a problem with the XPC service, it's possible that one of the required
-        // dictionary elements is not set. In that case, throw a general error.
-        if(![info objectForKey:@"status"] || ![info objectForKey:@"errors"] || ![info objectForKey:@"exitcode"] || ![info objectForKey:@"output"]) {
+        if(![info objectForKey:@"status"] || ![info objectForKey:@"errors"] || ![info objectForKey:@"exitcode"]) {
             taskError = [[GPGException exceptionWithReason:@"Erron in XPC response" errorCode:GPGErrorXPCConnectionError] retain];
             [self completeTaskWithFailure];
-
             return;
         }
         [result setObject:[info objectForKey:@"status"] forKey:@"status"];
@@ -224,16 +273,28 @@
 			[result setObject:[info objectForKey:@"attributes"] forKey:@"attributes"];
         [result setObject:[info objectForKey:@"errors"] forKey:@"errors"];
 		[result setObject:[info objectForKey:@"exitcode"] forKey:@"exitStatus"];
-		[result setObject:[info objectForKey:@"output"] forKey:@"output"];
 		
         [self completeTaskWithSuccess];
 	}];
 	
+	// The service got its own copies of the remote ends with the message.
+	// Close ours, otherwise EOF would never be seen.
+	[inputPipe.fileHandleForReading closeFile];
+	[outputPipe.fileHandleForWriting closeFile];
+	
 	[self waitForTaskToCompleteAndShutdown:NO throwExceptionIfNecessary:NO];
 	
-	if(!_success) {
+	// Wait until all output was received. When the service is gone, its end of the pipe is closed too.
+	dispatch_group_wait(streamGroup, DISPATCH_TIME_FOREVER);
+	dispatch_release(streamGroup);
+	
+	if(!_success || streamError) {
 		if(taskError)
 			self.taskError = taskError;
+		else if(streamError)
+			self.taskError = streamError;
+		[taskError release];
+		[streamError release];
 		
 		[result release];
 		[self shutdownAndThrowError];
@@ -245,6 +306,13 @@
 	return [result autorelease];
 }
 
+- (NSException *)exceptionFromInfo:(NSDictionary *)exceptionInfo {
+	if(![exceptionInfo objectForKey:@"errorCode"]) {
+		return [NSException exceptionWithName:[exceptionInfo objectForKey:@"name"] reason:[exceptionInfo objectForKey:@"reason"] userInfo:nil];
+	}
+	return [GPGException exceptionWithReason:[exceptionInfo objectForKey:@"reason"] errorCode:[[exceptionInfo objectForKey:@"errorCode"] unsignedIntValue]];
+}
+
 - (NSString *)loadConfigFileAtPath:(NSString *)path {
 	[self prepareTask];
 	
@@ -393,12 +461,10 @@
 	[_connectionError release];
 	_connectionError = nil;
 	
+	[_jailfree release];
 	_jailfree = nil;
 	
-	_connection.invalidationHandler = nil;
-	_connection.interruptionHandler = nil;
-	[_connection invalidate];
-	_connection.exportedObject = nil;
+	// Only drop the reference, the connection is reused by the next request.
 	[_connection release];
 	_connection = nil;
 	
@@ -0,0 +1,45 @@
+//
+//  GPGTaskLaunchContext.h
+//  Libmacgpg
+//
+
+#import <Foundation/Foundation.h>
+
+/*
+ * GPGTaskLaunchContext holds everything GPGTaskHelper needs to spawn gpg,
+ * which is the same for every task: the path of the gpg executable,
+ * the environment (as dictionary and as envp array) and the temp directory
+ * used for fifos.
+ *
+ * A context is immutable. +currentContext returns a process-wide shared
+ * instance, which is rebuilt after GPGConfigurationModifiedNotification
+ * or an explicit call to +invalidate. Tasks which are already running keep
+ * their own reference to the old context.
+ */
+@interface GPGTaskLaunchContext : NSObject {
+	NSString *_gpgPath;
+	NSDictionary *_environment;
+	char **_envp;
+	NSString *_tempDir;
+}
+
+/* The full path of gpg2 or gpg. nil if no usable gpg was found. */
+@property (nonatomic, readonly) NSString *gpgPath;
+/* The environment of this process. */
+@property (nonatomic, readonly) NSDictionary *environment;
+/* The environment as NULL terminated array of "KEY=VALUE" strings. */
+@property (nonatomic, readonly) char * const *envp;
+/* $TMPDIR/org.gpgtools.libmacgpg, already created. nil if it couldn't be created. */
+@property (nonatomic, readonly) NSString *tempDir;
+
+
+/* Returns the shared context, creates it if necessary. */
++ (GPGTaskLaunchContext *)currentContext;
+
+/* Discard the shared context. The next call to +currentContext creates a new one. */
++ (void)invalidate;
+
+/* Returns the environment with the given variables added. */
+- (NSDictionary *)environmentWithVariables:(NSDictionary *)variables;
+
+@end
@@ -0,0 +1,134 @@
+//
+//  GPGTaskLaunchContext.m
+//  Libmacgpg
+//
+
+#import "GPGTaskLaunchContext.h"
+#import "GPGTaskHelper.h"
+#import "GPGGlobals.h"
+
+
+@interface GPGTaskLaunchContext ()
+- (instancetype)initWithCurrentEnvironment;
+@end
+
+@implementation GPGTaskLaunchContext
+@synthesize gpgPath=_gpgPath, environment=_environment, tempDir=_tempDir;
+
+static GPGTaskLaunchContext *currentContext = nil;
+static NSObject *contextLock = nil;
+
+
++ (void)initialize {
+	if (self != [GPGTaskLaunchContext class]) {
+		return;
+	}
+	contextLock = [[NSObject alloc] init];
+
+	// gpg.conf, gpg-agent.conf or dirmngr.conf changed. This might mean a different
+	// gpg or a different environment, so simply build a new context when it's needed next time.
+	[[NSDistributedNotificationCenter defaultCenter] addObserver:self selector:@selector(configurationModified:) name:GPGConfigurationModifiedNotification object:nil];
+}
+
++ (void)configurationModified:(NSNotification *)notification {
+	[self invalidate];
+}
+
++ (GPGTaskLaunchContext *)currentContext {
+	GPGTaskLaunchContext *context;
+	@synchronized(contextLock) {
+		if (!currentContext) {
+			context = [[self alloc] initWithCurrentEnvironment];
+			if (context.gpgPath && context.tempDir) {
+				// Only cache a complete context. Otherwise try again next time,
+				// gpg might be installed in the meantime.
+				currentContext = [context retain];
+			}
+			[context autorelease];
+		} else {
+			context = [[currentContext retain] autorelease];
+		}
+	}
+	return context;
+}
+
++ (void)invalidate {
+	@synchronized(contextLock) {
+		[currentContext release];
+		currentContext = nil;
+	}
+}
+
+
+- (instancetype)initWithCurrentEnvironment {
+	self = [super init];
+	if (!self) {
+		return nil;
+	}
+
+	NSFileManager *fileManager = [NSFileManager defaultManager];
+
+	NSString *gpgPath = [GPGTaskHelper findExecutableWithName:@"gpg2"];
+	if (!gpgPath) {
+		gpgPath = [GPGTaskHelper findExecutableWithName:@"gpg"];
+	}
+	if (gpgPath && [fileManager isExecutableFileAtPath:gpgPath]) {
+		_gpgPath = [gpgPath copy];
+	}
+
+	_environment = [[NSProcessInfo processInfo].environment copy];
+
+	NSUInteger count = _environment.count;
+	_envp = malloc((count + 1) * sizeof(char *));
+	if (_envp) {
+		NSUInteger i = 0;
+		for (NSString *key in _environment) {
+			NSString *entry = [NSString stringWithFormat:@"%@=%@", key, _environment[key]];
+			_envp[i++] = strdup(entry.UTF8String);
+		}
+		_envp[i] = NULL;
+	}
+
+	NSString *tempDir = [NSTemporaryDirectory() stringByAppendingPathComponent:@"org.gpgtools.libmacgpg"];
+	NSError *error = nil;
+	if ([fileManager createDirectoryAtPath:tempDir withIntermediateDirectories:YES attributes:nil error:&error]) {
+		_tempDir = [tempDir copy];
+	} else {
+		GPGDebugLog(@"createDirectory failed: %@", error.localizedDescription);
+	}
+
+	return self;
+}
+
+- (char * const *)envp {
+	return _envp;
+}
+
+- (NSDictionary *)environmentWithVariables:(NSDictionary *)variables {
+	if (variables.count == 0) {
+		return _environment;
+	}
+	NSMutableDictionary *environment = [[_environment mutableCopy] autorelease];
+	[environment addEntriesFromDictionary:variables];
+	return environment;
+}
+
+- (void)dealloc {
+	if (_envp) {
+		for (char **entry = _envp; *entry; entry++) {
+			free(*entry);
+		}
+		free(_envp);
+		_envp = NULL;
+	}
+	[_gpgPath release];
+	_gpgPath = nil;
+	[_environment release];
+	_environment = nil;
+	[_tempDir release];
+	_tempDir = nil;
+
+	[super dealloc];
+}
+
+@end
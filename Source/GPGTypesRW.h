@@ -38,6 +38,7 @@
 @property (nonatomic, copy, readwrite) NSString *keyID;
 @property (nonatomic, copy, readwrite) NSString *fingerprint;
 @property (nonatomic, copy, readwrite) NSString *cardID;
+@property (nonatomic, copy, readwrite) NSString *keygrip;
 @property (nonatomic, copy, readwrite) NSDate *creationDate;
 @property (nonatomic, copy, readwrite) NSDate *expirationDate;
 @property (nonatomic, assign, readwrite) unsigned int length;
@@ -51,6 +52,7 @@
 
 @property (nonatomic, assign, readwrite) GPGKey *primaryKey;
 @property (nonatomic, assign, readwrite) GPGUserID *primaryUserID;
+@property (nonatomic, assign, readwrite) GPGKeyManager *keyManager;
 
 @property (nonatomic, assign, readwrite) BOOL secret;
 
@@ -75,6 +77,7 @@
 @property (nonatomic, copy, readwrite) NSString *comment;
 @property (nonatomic, copy, readwrite) NSString *hashID;
 @property (nonatomic, copy, readwrite) NSImage *image;
+@property (nonatomic, copy, readwrite) NSData *imageData;
 @property (nonatomic, copy, readwrite) NSDate *creationDate;
 @property (nonatomic, copy, readwrite) NSDate *expirationDate;
 @property (nonatomic, assign, readwrite) GPGValidity validity;
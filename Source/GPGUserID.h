@@ -38,6 +38,7 @@
 	NSString *_comment;
 	NSString *_hashID;
 	NSImage *_image;
+	NSData *_imageData; // The JPEG data of a photo ID.
 	NSDate *_creationDate;
 	NSDate *_expirationDate;
 	GPGValidity _validity;
@@ -56,11 +57,14 @@
 @property (nonatomic, readonly) NSString *email;
 @property (nonatomic, readonly) NSString *comment;
 @property (nonatomic, readonly) NSString *hashID;
+// A photo ID is decoded in the background, the first access returns nil. Observers of image are notified
+// (KVO) when the decoded image is available. Nil for user IDs without a photo.
 @property (nonatomic, readonly) NSImage *image;
 @property (nonatomic, readonly) NSDate *creationDate;
 @property (nonatomic, readonly) NSDate *expirationDate;
 @property (nonatomic, readonly) GPGValidity validity;
 
+// nil, if the key was loaded without signatures. Like -[GPGKey signatures], accessing it starts loading them.
 @property (nonatomic, readonly) NSArray *signatures;
 @property (nonatomic, readonly) GPGUserIDSignature *selfSignature;
 @property (nonatomic, readonly) GPGUserIDSignature *revocationSignature;
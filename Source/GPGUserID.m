@@ -19,10 +19,13 @@
 
 #import "GPGUserID.h"
 #import "GPGTypesRW.h"
+#import "GPGSignatureList.h"
+#import "GPGKeyManager.h"
+#import "GPGImageCache.h"
 
 
 @implementation GPGUserID
-@synthesize userIDDescription=_userIDDescription, name=_name, email=_email, comment=_comment, hashID=_hashID, primaryKey=_primaryKey, image=_image, expirationDate=_expirationDate, creationDate=_creationDate, validity=_validity;
+@synthesize userIDDescription=_userIDDescription, name=_name, email=_email, comment=_comment, hashID=_hashID, primaryKey=_primaryKey, image=_image, imageData=_imageData, expirationDate=_expirationDate, creationDate=_creationDate, validity=_validity;
 
 - (instancetype)init {
 	return [self initWithUserIDDescription:nil];
@@ -56,17 +59,23 @@
 		GPGUserIDSignature *revSig = nil;
 		GPGUserIDSignature *selfSig = nil;
 		NSString *keyID = _primaryKey.keyID;
-		for (GPGUserIDSignature *sig in signatures) {
-			if (sig.validity != GPGValidityUltimate) {
-				continue;
-			}
-			if (sig.revocation) {
-				if (!revSig) {
-					revSig = sig;
+		if ([signatures isKindOfClass:[GPGSignatureList class]]) {
+			// Don't create every signature of the list.
+			revSig = [(GPGSignatureList *)signatures firstRevocationSignatureOnlyValid:YES];
+			selfSig = [(GPGSignatureList *)signatures newestValidSignatureByKeyID:keyID];
+		} else {
+			for (GPGUserIDSignature *sig in signatures) {
+				if (sig.validity != GPGValidityUltimate) {
+					continue;
 				}
-			} else if ([keyID isEqualToString:sig.keyID]) {
-				if (!selfSig.creationDate || [sig.creationDate compare:selfSig.creationDate] == NSOrderedDescending) {
-					selfSig = sig;
+				if (sig.revocation) {
+					if (!revSig) {
+						revSig = sig;
+					}
+				} else if ([keyID isEqualToString:sig.keyID]) {
+					if (!selfSig.creationDate || [sig.creationDate compare:selfSig.creationDate] == NSOrderedDescending) {
+						selfSig = sig;
+					}
 				}
 			}
 		}
@@ -86,8 +95,19 @@
 	}
 }
 - (NSArray *)signatures {
+	if (!_signatures && _primaryKey) {
+		// Signatures are only loaded when they're used.
+		[_primaryKey.keyManager loadSignaturesOfKeyIfNeeded:_primaryKey];
+	}
 	return [[_signatures retain] autorelease];
 }
+- (NSImage *)image {
+	if (!_image && _imageData) {
+		// Photos are decoded in the background, when they're used. Observers of image are notified.
+		return [[GPGImageCache sharedCache] imageForUserID:self];
+	}
+	return [[_image retain] autorelease];
+}
 - (GPGUserIDSignature *)revocationSignature {
 	return [[_revocationSignature retain] autorelease];
 }
@@ -147,6 +167,8 @@
 	_comment = nil;
 	[_image release];
 	_image = nil;
+	[_imageData release];
+	_imageData = nil;
 	[_hashID release];
 	_hashID = nil;
 	[_revocationSignature release];
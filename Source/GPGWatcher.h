@@ -25,6 +25,7 @@ extern NSString * const GPGKeysChangedNotification;
     NSXPCConnection *jailfree;
 #endif
     BOOL _checkForSandbox;
+	NSNotificationCenter *_notificationCenter;
 }
 
 // default is 1.0
@@ -34,6 +35,10 @@ extern NSString * const GPGKeysChangedNotification;
 #if defined(__MAC_OS_X_VERSION_MAX_ALLOWED) && __MAC_OS_X_VERSION_MAX_ALLOWED >= 1080
 @property (nonatomic, retain) NSXPCConnection *jailfree;
 #endif
+// Posted notifications use this as object.
+@property (nonatomic, readonly) NSString *identifier;
+// The notifications are posted to this center. Default is nil, for the NSDistributedNotificationCenter.
+@property (nonatomic, retain) NSNotificationCenter *notificationCenter;
 + (id)sharedInstance;
 + (void)activate;
 
@@ -19,6 +19,8 @@ NSString * const GPGKeysChangedNotification = @"GPGKeysChangedNotification";
 @synthesize toleranceBefore;
 @synthesize toleranceAfter;
 @synthesize checkForSandbox = _checkForSandbox;
+@synthesize identifier;
+@synthesize notificationCenter = _notificationCenter;
 #if defined(__MAC_OS_X_VERSION_MAX_ALLOWED) && __MAC_OS_X_VERSION_MAX_ALLOWED >= 1080
 @synthesize jailfree;
 #endif
@@ -44,6 +46,7 @@ static NSString * const kWatchedFileName = @"watchedFileName";
     [changeDates release];
     [filesToWatch release];
     [gpgSpecifiedHome release];
+    [_notificationCenter release];
     [super dealloc];
 }
 
@@ -156,7 +159,9 @@ static NSString * const kWatchedFileName = @"watchedFileName";
         [[jailfree remoteObjectProxy] postNotificationName:name object:object];
 	} else
 #endif
-	{
+	if (_notificationCenter) {
+		[_notificationCenter postNotificationName:name object:object];
+	} else {
         [[NSDistributedNotificationCenter defaultCenter] postNotificationName:name object:object userInfo:nil options:0];
 	}
 }
@@ -29,10 +29,19 @@
 
 #import <Foundation/Foundation.h>
 
+@protocol Jail;
+
 @protocol Jailfree <NSObject>
 
 - (void)testConnection:(void (^)(BOOL))reply;
 - (void)launchGPGWithArguments:(NSArray *)arguments data:(NSData *)data readAttributes:(BOOL)readAttributes closeInput:(BOOL)closeInput reply:(void (^)(NSDictionary *))reply;
+/*
+ * Like above, but input and output are streamed through the passed file handles (ends of pipes),
+ * instead of being sent as a whole. input may be nil. inputLength is only used for progress.
+ * The reply doesn't contain the output, output is closed before reply is called.
+ * Status and progress are sent to callbacks, which is a proxy to an object of the client.
+ */
+- (void)launchGPGWithArguments:(NSArray *)arguments input:(NSFileHandle *)input inputLength:(NSUInteger)inputLength output:(NSFileHandle *)output readAttributes:(BOOL)readAttributes closeInput:(BOOL)closeInput callbacks:(id <Jail>)callbacks reply:(void (^)(NSDictionary *))reply;
 - (void)launchGeneralTask:(NSString *)path withArguments:(NSArray *)arguments wait:(BOOL)wait reply:(void (^)(BOOL))reply;
 
 - (void)startGPGWatcher;
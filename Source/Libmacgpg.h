@@ -20,9 +20,12 @@
 #import <Libmacgpg/GPGController.h>
 #import <Libmacgpg/GPGException.h>
 #import <Libmacgpg/GPGFileStream.h>
+#import <Libmacgpg/GPGFileHandleStream.h>
 #import <Libmacgpg/GPGGlobals.h>
 #import <Libmacgpg/GPGKey.h>
 #import <Libmacgpg/GPGKeyManager.h>
+#import <Libmacgpg/GPGKeyring.h>
+#import <Libmacgpg/GPGKeyEditTransaction.h>
 #import <Libmacgpg/GPGMemoryStream.h>
 #import <Libmacgpg/GPGOptions.h>
 #import <Libmacgpg/GPGRemoteKey.h>
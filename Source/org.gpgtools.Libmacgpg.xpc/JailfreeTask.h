@@ -16,6 +16,7 @@
 
 #pragma mark - GPGTaskHelper RPC methods
 - (void)launchGPGWithArguments:(NSArray *)arguments data:(NSData *)data readAttributes:(BOOL)readAttributes closeInput:(BOOL)closeInput reply:(void (^)(NSDictionary *))reply;
+- (void)launchGPGWithArguments:(NSArray *)arguments input:(NSFileHandle *)input inputLength:(NSUInteger)inputLength output:(NSFileHandle *)output readAttributes:(BOOL)readAttributes closeInput:(BOOL)closeInput callbacks:(id <Jail>)callbacks reply:(void (^)(NSDictionary *))reply;
 - (void)launchGeneralTask:(NSString *)path withArguments:(NSArray *)arguments wait:(BOOL)wait reply:(void (^)(BOOL))reply;
 
 #pragma mark - GPGWatcher RPC methods
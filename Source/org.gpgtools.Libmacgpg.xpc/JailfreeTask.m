@@ -8,12 +8,14 @@
 
 #import "JailfreeTask.h"
 #import "GPGMemoryStream.h"
+#import "GPGFileHandleStream.h"
 #import "GPGWatcher.h"
 #import "GPGException.h"
 #import "GPGTaskHelper.h"
 #import <xpc/xpc.h>
 
 @interface JailfreeTask ()
+- (void)launchGPGWithArguments:(NSArray *)arguments inputStream:(GPGStream *)inputStream outputStream:(GPGStream *)outputStream readAttributes:(BOOL)readAttributes closeInput:(BOOL)closeInput callbacks:(id <Jail>)remoteProxy reply:(void (^)(NSDictionary *))reply;
 - (BOOL)isCodeSignatureValidAtPath:(NSString *)path;
 @end
 
@@ -26,21 +28,36 @@
 }
 
 - (void)launchGPGWithArguments:(NSArray *)arguments data:(NSData *)data readAttributes:(BOOL)readAttributes closeInput:(BOOL)closeInput reply:(void (^)(NSDictionary *))reply {
+	GPGMemoryStream *outputStream = [[GPGMemoryStream alloc] init];
+	GPGMemoryStream *inputStream = [GPGMemoryStream memoryStreamForReading:data];
+	
+	[self launchGPGWithArguments:arguments inputStream:inputStream outputStream:outputStream readAttributes:readAttributes closeInput:closeInput callbacks:[_xpcConnection remoteObjectProxy] reply:reply];
+}
+
+- (void)launchGPGWithArguments:(NSArray *)arguments input:(NSFileHandle *)input inputLength:(NSUInteger)inputLength output:(NSFileHandle *)output readAttributes:(BOOL)readAttributes closeInput:(BOOL)closeInput callbacks:(id <Jail>)callbacks reply:(void (^)(NSDictionary *))reply {
+	// The data is streamed through the pipes, so neither the input nor the output
+	// has to be held in memory.
+	GPGFileHandleStream *inputStream = input ? [GPGFileHandleStream streamForReadingFromFileHandle:input length:inputLength] : nil;
+	GPGFileHandleStream *outputStream = [GPGFileHandleStream streamForWritingToFileHandle:output];
+	
+	[self launchGPGWithArguments:arguments inputStream:inputStream outputStream:outputStream readAttributes:readAttributes closeInput:closeInput callbacks:callbacks reply:^(NSDictionary *result) {
+		// The client waits for EOF on the output pipe.
+		[output closeFile];
+		[input closeFile];
+		reply(result);
+	}];
+}
+
+- (void)launchGPGWithArguments:(NSArray *)arguments inputStream:(GPGStream *)inputStream outputStream:(GPGStream *)outputStream readAttributes:(BOOL)readAttributes closeInput:(BOOL)closeInput callbacks:(id <Jail>)remoteProxy reply:(void (^)(NSDictionary *))reply {
     
 	GPGTaskHelper *task = [[GPGTaskHelper alloc] initWithArguments:arguments];
     
 	dispatch_group_t taskAndStatusGroup = dispatch_group_create();
 	
     // Setup the task.
-	GPGMemoryStream *outputStream = [[GPGMemoryStream alloc] init];
     task.output = outputStream;
-	
-	
-	GPGMemoryStream *inputStream = [GPGMemoryStream memoryStreamForReading:data];
-
     task.inData = inputStream;
 	task.closeInput = closeInput;
-	id <Jail> remoteProxy = [_xpcConnection remoteObjectProxy];
     typeof(task) __weak weakTask = task;
     
 	task.processStatus = (lp_process_status_t)^(NSString *keyword, NSString *value) {
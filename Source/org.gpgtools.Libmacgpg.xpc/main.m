@@ -9,6 +9,7 @@
 #include <Foundation/Foundation.h>
 #include "GPGGlobals.h"
 #include "JailfreeTask.h"
+#include "GPGJailfreeConnection.h"
 
 @interface JailfreeService : NSObject <NSXPCListenerDelegate>
 @end
@@ -16,7 +17,7 @@
 @implementation JailfreeService
 
 - (BOOL)listener:(NSXPCListener *)listener shouldAcceptNewConnection:(NSXPCConnection *)newConnection {
-    newConnection.exportedInterface = [NSXPCInterface interfaceWithProtocol:@protocol(Jailfree)];
+    newConnection.exportedInterface = [GPGJailfreeConnection jailfreeInterface];
     
     
     JailfreeTask *exportedObject = [[JailfreeTask alloc] init];
@@ -0,0 +1,91 @@
+//
+//  GPGColonListingStreamTest.m
+//  Libmacgpg
+//
+
+#import <XCTest/XCTest.h>
+#import "GPGColonListingStream.h"
+#import "GPGColonListing.h"
+
+@interface GPGColonListingStreamTest : XCTestCase
+@end
+
+@implementation GPGColonListingStreamTest
+
+- (NSArray *)fingerprints {
+	return @[@"85E38F69046B44C1EC9FB07B76D78F0500D026C4",
+			 @"D0C6C2F2B5B0D4F0A4D9E1B57E5A1B0C3A9F8E21",
+			 @"1F3E5A7C9B2D4F6E8A0C2E4F6A8B0D2F4E6A8C0E"];
+}
+
+- (NSData *)listingData {
+	NSMutableString *listing = [NSMutableString stringWithString:@"tru::1:1527681600:0:3:1:5\n"];
+	for (NSString *fingerprint in [self fingerprints]) {
+		[listing appendFormat:@"pub:u:4096:1:%@:1527681600:::u:::scESC:\n", [fingerprint substringFromIndex:24]];
+		[listing appendFormat:@"fpr:::::::::%@:\n", fingerprint];
+		[listing appendString:@"uid:u::::1527681600::ABC::Test <test@example.com>::::::::::0:\n"];
+		[listing appendString:@"sub:u:4096:1:0123456789ABCDEF:1527681600::::::e:\n"];
+	}
+	return [listing dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+// Writes data in pieces of the given sizes, repeating them until the end. Returns the fingerprints of all pub records passed to the handler.
+- (NSArray *)fingerprintsAfterWritingData:(NSData *)data inChunksOfSizes:(NSArray *)sizes {
+	NSMutableArray *fingerprints = [NSMutableArray array];
+	GPGColonListingStream *stream = [[GPGColonListingStream alloc] initWithHandler:^(GPGColonListing *listing) {
+		GPGColonRecord record;
+		for (NSUInteger i = 0; i < listing.lineCount; i++) {
+			[listing getRecord:&record atLine:i];
+			if (GPGColonRecordHasType(&record, "fpr") && i > 0 && [listing line:i - 1 hasType:"pub"]) {
+				[fingerprints addObject:GPGColonFieldString(GPGColonRecordField(&record, 9))];
+			}
+			XCTAssertFalse(i > 0 && [listing line:i hasType:"pub"], @"A listing contains more than one key start!");
+		}
+	}];
+
+	NSUInteger offset = 0, sizeIndex = 0;
+	while (offset < data.length) {
+		NSUInteger size = MIN([sizes[sizeIndex % sizes.count] unsignedIntegerValue], data.length - offset);
+		NSData *chunk = [data subdataWithRange:NSMakeRange(offset, size)];
+		[stream writeData:chunk];
+		offset += size;
+		sizeIndex++;
+	}
+	[stream finish];
+
+	XCTAssertEqual(stream.length, data.length, @"Wrong length!");
+	return fingerprints;
+}
+
+- (void)testSmallChunks {
+	NSData *data = [self listingData];
+	for (NSUInteger size = 1; size <= 8; size++) {
+		NSArray *fingerprints = [self fingerprintsAfterWritingData:data inChunksOfSizes:@[@(size)]];
+		XCTAssertEqualObjects(fingerprints, [self fingerprints], @"Wrong keys with chunks of %lu bytes!", (unsigned long)size);
+	}
+}
+
+- (void)testKeyStartSpanningWrites {
+	NSData *data = [self listingData];
+	NSString *string = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+	NSRange keyStart = [string rangeOfString:@"\npub:" options:0 range:NSMakeRange(1, string.length - 1)];
+
+	// Split "\npub:" at every position, followed by misaligned pieces.
+	for (NSUInteger split = 1; split < keyStart.length; split++) {
+		NSArray *sizes = @[@(keyStart.location + split), @3, @7, @2];
+		NSArray *fingerprints = [self fingerprintsAfterWritingData:data inChunksOfSizes:sizes];
+		XCTAssertEqualObjects(fingerprints, [self fingerprints], @"Wrong keys when splitting the key start after %lu bytes!", (unsigned long)split);
+	}
+}
+
+- (void)testKeepsData {
+	NSData *data = [self listingData];
+	GPGColonListingStream *stream = [[GPGColonListingStream alloc] initWithHandler:^(GPGColonListing *listing) {}];
+	stream.keepsData = YES;
+	[stream writeData:[data subdataWithRange:NSMakeRange(0, 100)]];
+	[stream writeData:[data subdataWithRange:NSMakeRange(100, data.length - 100)]];
+	[stream finish];
+	XCTAssertEqualObjects([stream readAllData], data, @"Output not kept!");
+}
+
+@end
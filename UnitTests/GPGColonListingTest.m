@@ -0,0 +1,76 @@
+//
+//  GPGColonListingTest.m
+//  Libmacgpg
+//
+
+#import <XCTest/XCTest.h>
+#import "GPGColonListing.h"
+
+@interface GPGColonListingTest : XCTestCase
+@end
+
+@implementation GPGColonListingTest
+
+- (GPGColonListing *)listingWithString:(NSString *)string {
+	return [GPGColonListing listingWithData:[string dataUsingEncoding:NSUTF8StringEncoding]];
+}
+
+- (void)testLines {
+	GPGColonListing *listing = [self listingWithString:@"tru::1:1527681600:0:3:1:5\npub:u:4096:1:77270A31BEF3BBE0:1527681600:::u:::scESC:\r\nfpr:::::::::85E38F69046B44C1EC9FB07B76D78F0500D026C4:"];
+	XCTAssertEqual(listing.lineCount, 3, @"Wrong number of lines!");
+
+	XCTAssertTrue([listing line:1 hasType:"pub"], @"Type not detected!");
+	XCTAssertFalse([listing line:1 hasType:"pu"], @"Type must match the whole field!");
+	XCTAssertFalse([listing line:3 hasType:"fpr"], @"Line out of bounds!");
+
+	GPGColonRecord record;
+	XCTAssertTrue([listing getRecord:&record atLine:1], @"Line not found!");
+	XCTAssertTrue(GPGColonRecordHasType(&record, "pub"), @"Wrong type!");
+	XCTAssertEqual(record.count, 13, @"Wrong number of fields!");
+	XCTAssertEqualObjects(GPGColonFieldString(GPGColonRecordField(&record, 4)), @"77270A31BEF3BBE0", @"Wrong key id!");
+	XCTAssertEqualObjects(GPGColonFieldString(GPGColonRecordField(&record, 11)), @"scESC", @"Wrong capabilities!");
+	XCTAssertEqual(GPGColonRecordField(&record, 12).length, 0, @"Carriage return not removed!");
+	XCTAssertEqual(GPGColonFieldInteger(GPGColonRecordField(&record, 2)), 4096, @"Wrong length!");
+	XCTAssertEqual(GPGColonFieldValidity(GPGColonRecordField(&record, 1)), GPGValidityUltimate, @"Wrong validity!");
+	XCTAssertEqual(GPGColonRecordField(&record, 20).length, 0, @"Missing fields must be empty!");
+
+	[listing getRecord:&record atLine:2];
+	XCTAssertEqualObjects(GPGColonFieldString(GPGColonRecordField(&record, 9)), @"85E38F69046B44C1EC9FB07B76D78F0500D026C4", @"Last line not parsed!");
+}
+
+- (void)testEmptyData {
+	XCTAssertEqual([self listingWithString:@""].lineCount, 0, @"Empty data has no lines!");
+	XCTAssertEqual([GPGColonListing listingWithData:nil].lineCount, 0, @"nil has no lines!");
+}
+
+- (void)testUnescapedString {
+	GPGColonListing *listing = [self listingWithString:@"uid:u::::1527681600::ABC::M\\xc3\\xbcller \\x3a Test <test@example.com>::::::::::0:\n"];
+	GPGColonRecord record;
+	[listing getRecord:&record atLine:0];
+
+	XCTAssertEqualObjects(GPGColonFieldUnescapedString(GPGColonRecordField(&record, 9)), @"Müller : Test <test@example.com>", @"Wrong user id!");
+	XCTAssertEqualObjects(GPGColonFieldUnescapedString(GPGColonRecordField(&record, 9)), [GPGColonFieldString(GPGColonRecordField(&record, 9)) unescapedString], @"Differs from -unescapedString!");
+}
+
+- (void)testDates {
+	GPGColonListing *listing = [self listingWithString:@"sig:!::1:77270A31BEF3BBE0:1527681600:20180530T120000::::13x:\n"];
+	GPGColonRecord record;
+	[listing getRecord:&record atLine:0];
+
+	NSArray *fields = @[@5, @6, @7];
+	for (NSNumber *index in fields) {
+		GPGColonField field = GPGColonRecordField(&record, index.unsignedIntegerValue);
+		XCTAssertEqualObjects(GPGColonFieldDate(field), [NSDate dateWithGPGString:GPGColonFieldString(field)], @"Differs from +dateWithGPGString: for field %@!", index);
+	}
+}
+
+- (void)testLatin1Fallback {
+	const char bytes[] = "uid:-::::::::J\xf6rg:";
+	GPGColonListing *listing = [GPGColonListing listingWithData:[NSData dataWithBytes:bytes length:sizeof(bytes) - 1]];
+	GPGColonRecord record;
+	[listing getRecord:&record atLine:0];
+
+	XCTAssertEqualObjects(GPGColonFieldString(GPGColonRecordField(&record, 9)), @"Jörg", @"Invalid UTF-8 not decoded as ISO Latin 1!");
+}
+
+@end
@@ -0,0 +1,88 @@
+//
+//  GPGKeyEditTransactionTest.m
+//  Libmacgpg
+//
+
+#import <XCTest/XCTest.h>
+#import "GPGController.h"
+#import "GPGKeyEditTransaction.h"
+#import "GPGTaskOrder.h"
+#import "GPGTypesRW.h"
+
+@interface GPGController ()
+- (NSArray <GPGTaskOrder *> *)signatureOrdersForKeyEdits:(NSArray *)edits indexes:(NSMapTable *)indexes;
+@end
+
+@interface GPGKeyEditTransactionTest : XCTestCase
+@end
+
+@implementation GPGKeyEditTransactionTest
+
+- (GPGKey *)keyWithKeyID:(NSString *)keyID secret:(BOOL)secret {
+	GPGKey *key = [[GPGKey alloc] init];
+	key.keyID = keyID;
+	key.fingerprint = [@"000000000000000000000000" stringByAppendingString:keyID];
+	key.primaryKey = key;
+	key.secret = secret;
+	return key;
+}
+
+- (GPGUserIDSignature *)signatureByKey:(GPGKey *)signer {
+	GPGUserIDSignature *signature = [[GPGUserIDSignature alloc] initWithKeyID:signer.keyID];
+	signature.primaryKey = signer;
+	return signature;
+}
+
+// Answers the prompts in the order gpg asks them, like GPGTask does.
+- (NSArray *)answersOfOrder:(GPGTaskOrder *)order forPrompts:(NSArray *)prompts {
+	NSMutableArray *answers = [NSMutableArray array];
+	for (NSString *prompt in prompts) {
+		NSInteger statusCode = [prompt isEqualToString:@"keyedit.prompt"] ? GPG_STATUS_GET_LINE : GPG_STATUS_GET_BOOL;
+		NSString *answer = [order cmdForPrompt:prompt statusCode:statusCode];
+		[answers addObject:answer ? answer : @""];
+	}
+	return answers;
+}
+
+- (void)testSignatureSessions {
+	GPGKey *key = [self keyWithKeyID:@"1111111111111111" secret:NO];
+	GPGKey *ownKey = [self keyWithKeyID:@"2222222222222222" secret:YES];
+	GPGKey *otherKey = [self keyWithKeyID:@"3333333333333333" secret:NO];
+	
+	GPGUserIDSignature *ownSignature1 = [self signatureByKey:ownKey];
+	GPGUserIDSignature *ownSignature2 = [self signatureByKey:ownKey];
+	GPGUserIDSignature *otherSignature = [self signatureByKey:otherKey];
+	
+	GPGUserID *userID = [[GPGUserID alloc] init];
+	userID.hashID = @"ABCDEF";
+	userID.primaryKey = key;
+	userID.signatures = @[ownSignature1, ownSignature2, otherSignature];
+	key.userIDs = @[userID];
+	
+	GPGKeyEditTransaction *transaction = [GPGKeyEditTransaction transaction];
+	[transaction removeSignature:ownSignature1 fromUserID:userID];
+	[transaction revokeSignature:ownSignature2 fromUserID:userID reason:0 description:nil];
+	[transaction removeSignature:otherSignature fromUserID:userID];
+	
+	NSMapTable *indexes = [NSMapTable strongToStrongObjectsMapTable];
+	for (GPGKeyEdit *edit in transaction.edits) {
+		[indexes setObject:[NSIndexSet indexSetWithIndex:1] forKey:edit];
+	}
+	
+	NSArray *orders = [[GPGController gpgController] signatureOrdersForKeyEdits:transaction.edits indexes:indexes];
+	XCTAssertEqual(orders.count, 2, @"Expected one session for the removals and one for the revocation!");
+	
+	// Both removals are answered by one delsig, before the revocation.
+	NSArray *answers = [self answersOfOrder:orders[0] forPrompts:@[@"keyedit.prompt", @"keyedit.prompt", @"keyedit.prompt", @"keyedit.prompt",
+																  @"keyedit.delsig.valid", @"keyedit.delsig.valid", @"keyedit.delsig.valid", @"keyedit.prompt"]];
+	NSArray *expected = @[@"uid 0\n", @"key 0\n", @"uid 1\n", @"delsig\n", @"y\n", @"n\n", @"y\n", @"save\n"];
+	XCTAssertEqualObjects(answers, expected, @"Wrong answers for delsig!");
+	
+	// gpg only asks for the remaining signature of the own key.
+	answers = [self answersOfOrder:orders[1] forPrompts:@[@"keyedit.prompt", @"keyedit.prompt", @"keyedit.prompt", @"keyedit.prompt",
+														  @"ask_revoke_sig.one", @"ask_revoke_sig.okay"]];
+	expected = @[@"uid 0\n", @"key 0\n", @"uid 1\n", @"revsig\n", @"y\n", @"y\n"];
+	XCTAssertEqualObjects(answers, expected, @"Wrong answers for revsig!");
+}
+
+@end
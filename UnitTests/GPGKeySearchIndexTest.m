@@ -0,0 +1,72 @@
+//
+//  GPGKeySearchIndexTest.m
+//  Libmacgpg
+//
+
+#import <XCTest/XCTest.h>
+#import "GPGKeySearchIndex.h"
+#import "GPGTypesRW.h"
+
+@interface GPGKeySearchIndexTest : XCTestCase
+@end
+
+@implementation GPGKeySearchIndexTest
+
+- (GPGKey *)keyWithFingerprint:(NSString *)fingerprint userID:(NSString *)description {
+	GPGKey *key = [[GPGKey alloc] initWithFingerprint:fingerprint];
+	key.keyID = [fingerprint substringFromIndex:24];
+	GPGUserID *userID = [[GPGUserID alloc] init];
+	userID.userIDDescription = description;
+	key.userIDs = @[userID];
+	return key;
+}
+
+- (void)testSearch {
+	GPGKeySearchIndex *index = [[GPGKeySearchIndex alloc] init];
+	GPGKey *alice = [self keyWithFingerprint:@"85E38F69046B44C1EC9FB07B76D78F0500D026C4" userID:@"Alice Müller <alice@example.com>"];
+	GPGKey *bob = [self keyWithFingerprint:@"1111111111111111111111111111111111111111" userID:@"Bob <bob@example.org>"];
+	[index addKey:alice];
+	[index addKey:bob];
+
+	XCTAssertEqualObjects([index keysMatchingSearchString:@"example"], ([NSSet setWithObjects:alice, bob, nil]), @"Both keys must match!");
+	XCTAssertEqualObjects([index keysMatchingSearchString:@"ALICE@"], [NSSet setWithObject:alice], @"Case must be ignored!");
+	XCTAssertEqualObjects([index keysMatchingSearchString:@"muller"], [NSSet setWithObject:alice], @"Diacritics must be ignored!");
+	XCTAssertEqualObjects([index keysMatchingSearchString:@"0x00d026c4"], [NSSet setWithObject:alice], @"Key ID not found!");
+	XCTAssertEqualObjects([index keysMatchingSearchString:@"bo"], [NSSet setWithObject:bob], @"Short search failed!");
+	XCTAssertEqual([index keysMatchingSearchString:@"bob <bob <bob"].count, 0, @"All trigrams exist, but not in this order!");
+	XCTAssertEqual([index keysMatchingSearchString:@"xyz"].count, 0, @"Unknown trigram must not match!");
+}
+
+- (void)testUpdate {
+	GPGKeySearchIndex *index = [[GPGKeySearchIndex alloc] init];
+	NSString *fingerprint = @"85E38F69046B44C1EC9FB07B76D78F0500D026C4";
+	[index addKey:[self keyWithFingerprint:fingerprint userID:@"Alice <alice@example.com>"]];
+
+	GPGKey *changed = [self keyWithFingerprint:fingerprint userID:@"Alice <alice@example.net>"];
+	[index addKey:changed];
+	XCTAssertEqual([index keysMatchingSearchString:@"example.com"].count, 0, @"Old text of a replaced key still found!");
+	XCTAssertEqualObjects([index keysMatchingSearchString:@"example.net"], [NSSet setWithObject:changed], @"New text not found!");
+
+	[index removeKeyWithFingerprint:fingerprint];
+	XCTAssertEqual([index keysMatchingSearchString:@"alice"].count, 0, @"Removed key still found!");
+}
+
+- (void)testRebuild {
+	GPGKeySearchIndex *index = [[GPGKeySearchIndex alloc] init];
+	NSMutableArray *fingerprints = [NSMutableArray array];
+	for (NSUInteger i = 0; i < 3000; i++) {
+		NSString *fingerprint = [NSString stringWithFormat:@"%040lX", (unsigned long)i];
+		[fingerprints addObject:fingerprint];
+		[index addKey:[self keyWithFingerprint:fingerprint userID:[NSString stringWithFormat:@"User %lu <user%lu@example.com>", (unsigned long)i, (unsigned long)i]]];
+	}
+	// Removes more keys than remain, so the index is rebuilt.
+	for (NSUInteger i = 0; i < 2000; i++) {
+		[index removeKeyWithFingerprint:fingerprints[i]];
+	}
+
+	XCTAssertEqual([index keysMatchingSearchString:@"example.com"].count, 1000, @"Wrong number of keys after rebuild!");
+	XCTAssertEqual([index keysMatchingSearchString:@"user2999@"].count, 1, @"Key not found after rebuild!");
+	XCTAssertEqual([index keysMatchingSearchString:@"user1999@"].count, 0, @"Removed key found after rebuild!");
+}
+
+@end
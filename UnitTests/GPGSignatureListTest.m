@@ -0,0 +1,117 @@
+//
+//  GPGSignatureListTest.m
+//  Libmacgpg
+//
+
+#import <XCTest/XCTest.h>
+#import "GPGSignatureList.h"
+#import "GPGKeyManager.h"
+#import "GPGTypesRW.h"
+
+@interface GPGKeyManager ()
+- (void)fillKey:(GPGKey *)primaryKey fromListing:(GPGColonListing *)listing range:(NSRange)lineRange;
+@end
+
+@interface GPGSignatureListTest : XCTestCase
+@end
+
+@implementation GPGSignatureListTest
+
+// A key with one user ID, listed like gpg --check-sigs does.
+- (GPGKey *)keyWithSignatures {
+	NSString *string =
+	@"pub:u:4096:1:76D78F0500D026C4:1527681600:::u:::scESC:\n"
+	@"fpr:::::::::85E38F69046B44C1EC9FB07B76D78F0500D026C4:\n"
+	@"uid:u::::1527681600::ABCDEF0123456789ABCDEF0123456789ABCDEF01::Test <test@example.com>::::::::::0:\n"
+	@"sig:!::1:76D78F0500D026C4:1527681600::::Test <test@example.com>:13x::85E38F69046B44C1EC9FB07B76D78F0500D026C4:::8:\n"
+	@"sig:!::1:76D78F0500D026C4:1530000000:1600000000:::Test <test@example.com>:13x::85E38F69046B44C1EC9FB07B76D78F0500D026C4:::10:\n"
+	@"sig:?::1:1122334455667788:1528000000::::[User ID not found]:10x:::::2:\n"
+	@"sig:!::1:1122334455667788:1528000000::::Other <other@example.com>:10l:::::8:\n"
+	@"sig:!::1:ABCD:1528000000::::Short:1:::::8:\n"
+	@"rev:?::1:1122334455667788:1528500000::::Other <other@example.com>:30x:::::8:\n"
+	@"rev:!::1:76D78F0500D026C4:1529000000::::Test <test@example.com>:30x::85E38F69046B44C1EC9FB07B76D78F0500D026C4:::8:\n"
+	@"spk:29:0:12:Key retired:\n";
+	GPGColonListing *listing = [GPGColonListing listingWithData:[string dataUsingEncoding:NSUTF8StringEncoding]];
+
+	GPGKeyManager *keyManager = [[GPGKeyManager alloc] initWithHomedir:NSTemporaryDirectory()];
+	[keyManager setValue:@YES forKey:@"fetchSignatures"];
+	GPGKey *key = [[GPGKey alloc] init];
+	[keyManager fillKey:key fromListing:listing range:NSMakeRange(0, listing.lineCount)];
+	return key;
+}
+
+- (void)testObjectIdentity {
+	GPGUserID *userID = [self keyWithSignatures].userIDs[0];
+	NSArray *signatures = userID.signatures;
+	XCTAssertTrue([signatures isKindOfClass:[GPGSignatureList class]], @"Signatures not packed!");
+	XCTAssertEqual(signatures.count, 7, @"Wrong number of signatures!");
+
+	for (NSUInteger i = 0; i < signatures.count; i++) {
+		XCTAssertEqual(signatures[i], [signatures objectAtIndex:i], @"Signature %lu created twice!", (unsigned long)i);
+	}
+	NSUInteger i = 0;
+	for (GPGUserIDSignature *signature in signatures) {
+		XCTAssertEqual(signature, signatures[i], @"Enumeration returns other objects!");
+		i++;
+	}
+	XCTAssertEqual([signatures indexOfObjectIdenticalTo:signatures[4]], 4, @"Identity lookup failed!");
+	XCTAssertEqual([signatures copy], signatures, @"Copy isn't the list itself!");
+}
+
+- (void)testFields {
+	GPGUserID *userID = [self keyWithSignatures].userIDs[0];
+	NSArray <GPGUserIDSignature *> *signatures = userID.signatures;
+
+	GPGUserIDSignature *signature = signatures[1];
+	XCTAssertEqualObjects(signature.keyID, @"76D78F0500D026C4", @"Wrong key id!");
+	XCTAssertEqual(signature.signatureClass, 0x13, @"Wrong class!");
+	XCTAssertEqual(signature.validity, GPGValidityUltimate, @"Wrong validity!");
+	XCTAssertEqual(signature.algorithm, 1, @"Wrong algorithm!");
+	XCTAssertEqual(signature.hashAlgorithm, 10, @"Wrong hash algorithm!");
+	XCTAssertEqualObjects(signature.creationDate, [NSDate dateWithTimeIntervalSince1970:1530000000], @"Wrong creation date!");
+	XCTAssertEqualObjects(signature.expirationDate, [NSDate dateWithTimeIntervalSince1970:1600000000], @"Wrong expiration date!");
+	XCTAssertNil(signatures[0].expirationDate, @"Expiration date without one!");
+	XCTAssertFalse(signature.revocation, @"Not a revocation!");
+
+	XCTAssertEqual(signatures[2].validity, GPGValidityUndefined, @"Wrong validity!");
+	XCTAssertTrue(signatures[3].local, @"Local signature not detected!");
+	XCTAssertEqualObjects(signatures[3].keyID, @"1122334455667788", @"Wrong key id!");
+
+	// Key IDs which aren't 16 hex digits are kept as they are. A class without two digits is -1.
+	XCTAssertEqualObjects(signatures[4].keyID, @"ABCD", @"Short key id changed!");
+	XCTAssertEqual(signatures[4].signatureClass, -1, @"Short class not detected!");
+
+	GPGUserIDSignature *revocation = signatures[6];
+	XCTAssertTrue(revocation.revocation, @"Revocation not detected!");
+	XCTAssertEqual(revocation.signatureClass, 0x30, @"Wrong class!");
+	XCTAssertEqualObjects(revocation.reason, @"Key retired", @"Wrong reason!");
+	XCTAssertNil(signatures[5].reason, @"Reason of another signature!");
+}
+
+- (void)testSearchMatchesPlainLoop {
+	GPGKey *key = [self keyWithSignatures];
+	GPGUserID *userID = key.userIDs[0];
+	GPGSignatureList *list = (GPGSignatureList *)userID.signatures;
+
+	// -[GPGUserID setSignatures:] uses the plain loop for any other array.
+	NSMutableArray *plainSignatures = [NSMutableArray array];
+	for (GPGUserIDSignature *signature in list) {
+		[plainSignatures addObject:signature];
+	}
+	GPGUserID *plainUserID = [[GPGUserID alloc] init];
+	plainUserID.primaryKey = key;
+	plainUserID.signatures = plainSignatures;
+
+	XCTAssertNotNil(userID.selfSignature, @"Self-signature not found!");
+	XCTAssertEqual(userID.selfSignature, plainUserID.selfSignature, @"Self-signatures differ!");
+	XCTAssertEqual(userID.selfSignature, list[1], @"Not the newest self-signature!");
+	XCTAssertEqual([list newestValidSignatureByKeyID:@"1122334455667788"], list[3], @"Wrong signature by key id!");
+	XCTAssertNil([list newestValidSignatureByKeyID:@"ABCDEF"], @"Signature of an unknown key!");
+
+	XCTAssertNotNil(userID.revocationSignature, @"Revocation not found!");
+	XCTAssertEqual(userID.revocationSignature, plainUserID.revocationSignature, @"Revocations differ!");
+	XCTAssertEqual([list firstRevocationSignatureOnlyValid:YES], list[6], @"Invalid revocation returned!");
+	XCTAssertEqual([list firstRevocationSignatureOnlyValid:NO], list[5], @"Not the first revocation!");
+}
+
+@end
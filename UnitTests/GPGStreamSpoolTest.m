@@ -0,0 +1,74 @@
+//
+//  GPGStreamSpoolTest.m
+//  Libmacgpg
+//
+
+#import <XCTest/XCTest.h>
+#import "GPGStreamSpool.h"
+#import "GPGMemoryStream.h"
+#import "GPGFileHandleStream.h"
+
+@interface GPGStreamSpoolTest : XCTestCase
+@end
+
+@implementation GPGStreamSpoolTest
+
+- (NSData *)testDataOfLength:(NSUInteger)length {
+	NSMutableData *data = [NSMutableData dataWithLength:length];
+	uint8_t *bytes = data.mutableBytes;
+	for (NSUInteger i = 0; i < data.length; i++) {
+		bytes[i] = (uint8_t)(i * 7);
+	}
+	return data;
+}
+
+// A stream, which isn't a GPGMemoryStream, so the spool has to read it.
+- (GPGStream *)pipeStreamWithData:(NSData *)data {
+	NSPipe *pipe = [NSPipe pipe];
+	dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+		[pipe.fileHandleForWriting writeData:data];
+		[pipe.fileHandleForWriting closeFile];
+	});
+	return [GPGFileHandleStream streamForReadingFromFileHandle:pipe.fileHandleForReading length:data.length];
+}
+
+- (void)testSmallData {
+	NSData *data = [self testDataOfLength:200 * 1024 + 17];
+	GPGStreamSpool *spool = [GPGStreamSpool spoolWithStream:[self pipeStreamWithData:data]];
+
+	GPGStream *first = [spool readingStream];
+	GPGStream *second = [spool readingStream];
+	XCTAssertEqual([second readByte], (NSInteger)((const uint8_t *)data.bytes)[0], @"Wrong first byte!");
+	XCTAssertEqualObjects([first readAllData], data, @"First stream incomplete!");
+	NSMutableData *secondData = [NSMutableData dataWithBytes:data.bytes length:1];
+	[secondData appendData:[second readDataToEndOfStream]];
+	XCTAssertEqualObjects(secondData, data, @"Second stream incomplete!");
+}
+
+- (void)testLargeData {
+	// More than the spool keeps in memory, so it's written to a file.
+	NSData *data = [self testDataOfLength:5 * 1024 * 1024 + 3];
+	NSArray *streams;
+	@autoreleasepool {
+		// The file is deleted with the spool.
+		GPGStreamSpool *spool = [GPGStreamSpool spoolWithStream:[self pipeStreamWithData:data]];
+		streams = @[[spool readingStream], [spool readingStream], [spool readingStream]];
+	}
+
+	// The streams are independent, they are read at a different pace.
+	XCTAssertEqual([streams[1] readDataOfLength:1000].length, 1000, @"Data missing!");
+	XCTAssertEqualObjects([streams[0] readDataToEndOfStream], data, @"First stream incomplete!");
+	NSMutableData *secondData = [NSMutableData dataWithData:[data subdataWithRange:NSMakeRange(0, 1000)]];
+	[secondData appendData:[streams[1] readDataToEndOfStream]];
+	XCTAssertEqualObjects(secondData, data, @"Second stream incomplete!");
+	XCTAssertEqualObjects([streams[2] readDataToEndOfStream], data, @"Streams still readable after the spool is gone!");
+}
+
+- (void)testMemoryStream {
+	NSData *data = [self testDataOfLength:1000];
+	GPGStreamSpool *spool = [GPGStreamSpool spoolWithStream:[GPGMemoryStream memoryStreamForReading:data]];
+	XCTAssertEqualObjects([[spool readingStream] readAllData], data, @"Stream incomplete!");
+	XCTAssertEqualObjects([[spool readingStream] readAllData], data, @"Second stream incomplete!");
+}
+
+@end
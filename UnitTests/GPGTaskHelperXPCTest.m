@@ -0,0 +1,127 @@
+//
+//  GPGTaskHelperXPCTest.m
+//  Libmacgpg
+//
+
+#import <XCTest/XCTest.h>
+#import "Libmacgpg.h"
+#import "GPGTaskHelperXPC.h"
+#import "GPGJailfreeConnection.h"
+
+
+/*
+ * In-process stand-in for org.gpgtools.Libmacgpg.xpc.
+ * Instead of running gpg, it copies the input to the output and reports the number of bytes as status.
+ */
+@interface GPGTaskHelperXPCTestService : NSObject <Jailfree, NSXPCListenerDelegate>
+@end
+
+@implementation GPGTaskHelperXPCTestService
+
+- (BOOL)listener:(NSXPCListener *)listener shouldAcceptNewConnection:(NSXPCConnection *)newConnection {
+	newConnection.exportedInterface = [GPGJailfreeConnection jailfreeInterface];
+	newConnection.exportedObject = self;
+	newConnection.remoteObjectInterface = [NSXPCInterface interfaceWithProtocol:@protocol(Jail)];
+	[newConnection resume];
+	return YES;
+}
+
+- (void)launchGPGWithArguments:(NSArray *)arguments input:(NSFileHandle *)input inputLength:(NSUInteger)inputLength output:(NSFileHandle *)output readAttributes:(BOOL)readAttributes closeInput:(BOOL)closeInput callbacks:(id <Jail>)callbacks reply:(void (^)(NSDictionary *))reply {
+	dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+		NSUInteger total = 0;
+		NSData *data;
+		while ((data = [input readDataOfLength:10000]) && data.length > 0) {
+			[output writeData:data];
+			total += data.length;
+		}
+		[output closeFile];
+
+		NSString *status = [NSString stringWithFormat:@"[GNUPG:] COPIED %lu %lu\n", (unsigned long)total, (unsigned long)inputLength];
+		reply(@{@"status": [status dataUsingEncoding:NSUTF8StringEncoding], @"errors": [NSData data], @"exitcode": @0});
+	});
+}
+
+- (void)testConnection:(void (^)(BOOL))reply {
+	reply(YES);
+}
+- (void)launchGPGWithArguments:(NSArray *)arguments data:(NSData *)data readAttributes:(BOOL)readAttributes closeInput:(BOOL)closeInput reply:(void (^)(NSDictionary *))reply {
+	reply(@{@"status": [NSData data], @"errors": [NSData data], @"exitcode": @0, @"output": data ? data : [NSData data]});
+}
+- (void)launchGeneralTask:(NSString *)path withArguments:(NSArray *)arguments wait:(BOOL)wait reply:(void (^)(BOOL))reply {
+	reply(NO);
+}
+- (void)startGPGWatcher {
+}
+- (void)loadConfigFileAtPath:(NSString *)path reply:(void (^)(NSString *))reply {
+	reply(nil);
+}
+- (void)loadUserDefaultsForName:(NSString *)domainName reply:(void (^)(NSDictionary *))reply {
+	reply(nil);
+}
+- (void)setUserDefaults:(NSDictionary *)domain forName:(NSString *)domainName reply:(void (^)(BOOL result))reply {
+	reply(NO);
+}
+- (void)isPassphraseForKeyInGPGAgentCache:(NSString *)key reply:(void (^)(BOOL result))reply {
+	reply(NO);
+}
+- (void)showGPGSuitePreferencesWithArguments:(NSDictionary *)arguments reply:(void (^)(BOOL result))reply {
+	reply(NO);
+}
+
+@end
+
+
+
+@interface GPGTaskHelperXPCTest : XCTestCase
+@property (nonatomic, strong) NSXPCListener *listener;
+@property (nonatomic, strong) GPGTaskHelperXPCTestService *service;
+@end
+
+@implementation GPGTaskHelperXPCTest
+
+- (void)setUp {
+	self.service = [GPGTaskHelperXPCTestService new];
+	self.listener = [NSXPCListener anonymousListener];
+	self.listener.delegate = self.service;
+	[self.listener resume];
+}
+
+- (void)tearDown {
+	[self.listener invalidate];
+	self.listener = nil;
+	self.service = nil;
+}
+
+- (void)testStreamedInputAndOutput {
+	// Much more than fits into a pipe buffer, so the data has to be streamed in both directions at once.
+	NSUInteger length = 8 * 1024 * 1024;
+	NSMutableData *inputData = [NSMutableData dataWithLength:length];
+	uint8_t *bytes = inputData.mutableBytes;
+	for (NSUInteger i = 0; i < length; i++) {
+		bytes[i] = (uint8_t)(i * 7);
+	}
+
+	GPGMemoryStream *input = [GPGMemoryStream memoryStreamForReading:inputData];
+	GPGMemoryStream *output = [GPGMemoryStream memoryStream];
+
+	GPGTaskHelperXPC *xpcTask = [[GPGTaskHelperXPC alloc] initWithListenerEndpoint:self.listener.endpoint];
+	NSDictionary *result = [xpcTask launchGPGWithArguments:@[] input:input output:output readAttributes:NO closeInput:YES];
+
+	NSString *expectedStatus = [NSString stringWithFormat:@"[GNUPG:] COPIED %lu %lu\n", (unsigned long)length, (unsigned long)length];
+	XCTAssertEqualObjects([[NSString alloc] initWithData:result[@"status"] encoding:NSUTF8StringEncoding], expectedStatus, @"Wrong status!");
+	XCTAssertEqualObjects(result[@"exitStatus"], @0, @"Wrong exit status!");
+	XCTAssertNil(result[@"output"], @"Streamed output should not be part of the result!");
+	XCTAssertEqualObjects(output.readAllData, inputData, @"Output differs from input!");
+}
+
+- (void)testWithoutInput {
+	GPGMemoryStream *output = [GPGMemoryStream memoryStream];
+
+	GPGTaskHelperXPC *xpcTask = [[GPGTaskHelperXPC alloc] initWithListenerEndpoint:self.listener.endpoint];
+	NSDictionary *result = [xpcTask launchGPGWithArguments:@[] input:nil output:output readAttributes:NO closeInput:YES];
+
+	XCTAssertEqualObjects([[NSString alloc] initWithData:result[@"status"] encoding:NSUTF8StringEncoding], @"[GNUPG:] COPIED 0 0\n", @"Wrong status!");
+	XCTAssertEqual(output.readAllData.length, 0, @"Unexpected output!");
+}
+
+@end